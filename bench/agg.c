@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define ELEMENTS 10000000
+#define QUERIES 1000000
+
+typedef struct column_metadata {
+    size_t length;
+    struct mida_agg agg;
+} ColumnMD;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// What callers write by hand, on every query
+static __attribute__((noinline)) void
+scan(const double *values, size_t n, double *sum, double *min, double *max)
+{
+    *sum = 0, *min = *max = values[0];
+    for (size_t i = 0; i < n; i++) {
+        *sum += values[i];
+        if (values[i] < *min) *min = values[i];
+        if (values[i] > *max) *max = values[i];
+    }
+}
+
+int
+main()
+{
+    double *values = mida_calloc(ColumnMD, sizeof *values, ELEMENTS);
+    double sum, min, max, start, check = 0;
+    unsigned long seed = 42;
+
+    if (!values) return 1;
+    MIDA(ColumnMD, values)->length = ELEMENTS;
+    for (int i = 0; i < ELEMENTS; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        values[i] = (double)(seed >> 40);
+    }
+
+    start = now();
+    scan(values, ELEMENTS, &sum, &min, &max);
+    printf("scalar scan:           %7.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    check += mida_agg_sum(ColumnMD, agg, values);
+    printf("mida_agg(), computed:  %7.2f ms\n", (now() - start) * 1e3);
+    check -= sum;
+
+    start = now();
+    for (int i = 0; i < QUERIES; i++)
+        check += mida_agg_max(ColumnMD, agg, values) - max;
+    printf("mida_agg(), cached:    %7.2f ns\n",
+           (now() - start) * 1e9 / QUERIES);
+
+    // Every modification invalidates the cache
+    start = now();
+    for (int i = 0; i < 10; i++) {
+        mida_agg_set(ColumnMD, agg, values, i, values[i] + 1);
+        check += mida_agg_min(ColumnMD, agg, values) - min;
+    }
+    printf("set then query:        %7.2f ms\n", (now() - start) * 1e3 / 10);
+
+    mida_free(ColumnMD, values);
+    return check < -1 || check > 1;
+}
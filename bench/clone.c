@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define NODES 1000000
+
+typedef struct node_metadata {
+    size_t depth;
+} NodeMD;
+
+struct node {
+    struct node *left, *right;
+    long value;
+};
+
+static const struct mida_type node_type;
+static const struct mida_field node_fields[] = {
+    MIDA_FIELD(struct node, left, &node_type),
+    MIDA_FIELD(struct node, right, &node_type),
+};
+static const struct mida_type node_type = { sizeof(NodeMD),
+                                            sizeof(struct node), NULL,
+                                            node_fields, 2 };
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Builds a random binary search tree, so nodes end up scattered in the heap
+static struct node *
+insert(struct node *root, long value, size_t depth)
+{
+    if (!root) {
+        struct node *node = mida_malloc(NodeMD, sizeof(struct node), 1);
+        node->left = node->right = NULL;
+        node->value = value;
+        MIDA(NodeMD, node)->depth = depth;
+        return node;
+    }
+    if (value < root->value)
+        root->left = insert(root->left, value, depth + 1);
+    else
+        root->right = insert(root->right, value, depth + 1);
+    return root;
+}
+
+static long
+sum(const struct node *node)
+{
+    return node ? node->value + (long)MIDA(NodeMD, node)->depth
+                      + sum(node->left) + sum(node->right)
+                : 0;
+}
+
+// Copies the tree with one mida_malloc per node
+static struct node *
+clone_naive(const struct node *node)
+{
+    struct node *copy;
+    if (!node) return NULL;
+    copy = mida_malloc(NodeMD, sizeof(struct node), 1);
+    *MIDA(NodeMD, copy) = *MIDA(NodeMD, node);
+    copy->value = node->value;
+    copy->left = clone_naive(node->left);
+    copy->right = clone_naive(node->right);
+    return copy;
+}
+
+int
+main()
+{
+    struct node *root = NULL, *naive, *deep;
+    unsigned long seed = 42;
+    double start;
+    long check = 0;
+
+    for (size_t i = 0; i < NODES; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        root = insert(root, (long)(seed >> 33), 0);
+    }
+
+    start = now();
+    naive = clone_naive(root);
+    printf("per-node clone:     %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    deep = mida_clone_deep(&node_type, root);
+    printf("mida_clone_deep():  %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    check += sum(naive);
+    printf("walk per-node copy: %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    check -= sum(deep);
+    printf("walk deep clone:    %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    mida_free_deep(&node_type, naive);
+    printf("mida_free_deep():   %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    mida_free(NodeMD, deep);
+    printf("free deep clone:    %8.2f ms\n", (now() - start) * 1e3);
+
+    mida_free_deep(&node_type, root);
+    return check != 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define ROWS 10000000
+#define QUERIES 20
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Filtering a plain array, reading every element
+static __attribute__((noinline)) size_t
+plain_count(const int64_t *values, size_t n, int64_t lo, int64_t hi)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++)
+        if (values[i] >= lo && values[i] <= hi) count++;
+    return count;
+}
+
+static void
+run(const char *name, const int64_t *column, int64_t lo, int64_t hi)
+{
+    size_t plain = 0, zoned = 0;
+    double start, plain_time, zoned_time;
+
+    start = now();
+    for (int q = 0; q < QUERIES; q++)
+        plain += plain_count(column, ROWS, lo + q, hi + q);
+    plain_time = (now() - start) * 1e3 / QUERIES;
+
+    start = now();
+    for (int q = 0; q < QUERIES; q++)
+        zoned += mida_column_scan(column, lo + q, hi + q, NULL, NULL);
+    zoned_time = (now() - start) * 1e3 / QUERIES;
+
+    printf("%-28s plain %6.2f ms, mida_column_scan %6.2f ms%s\n", name,
+           plain_time, zoned_time, plain == zoned ? "" : " (MISMATCH)");
+}
+
+int
+main()
+{
+    int64_t *timestamps = mida_column_new(ROWS), *random = NULL;
+    unsigned long seed = 42;
+
+    for (int64_t i = 0; i < ROWS; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        // Roughly ordered, as event times
+        mida_column_push(&timestamps, i * 10 + (int64_t)(seed >> 54));
+        mida_column_push(&random, (int64_t)(seed >> 24));
+    }
+
+    run("timestamps, 0.1% selected", timestamps, 50000000, 50100000);
+    run("timestamps, 10% selected", timestamps, 20000000, 30000000);
+    run("random, 1% selected", random, 0, (1L << 40) / 100);
+    run("random, none selected", random, -100, -1);
+
+    mida_column_free(timestamps);
+    mida_column_free(random);
+    return 0;
+}
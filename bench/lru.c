@@ -0,0 +1,96 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define THREADS 4
+#define OPS 1000000
+#define KEYS 100000
+#define BUDGET (16 << 20)
+
+typedef struct entry_metadata {
+    struct mida_lru_node node;
+    uint64_t id;
+} EntryMD;
+
+static struct mida_lru cache;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int
+entry_eq(const void *base, const void *key)
+{
+    return MIDA(EntryMD, base)->id == *(const uint64_t *)key;
+}
+
+static void
+entry_evict(void *base, void *context)
+{
+    (void)context;
+    mida_free(EntryMD, base);
+}
+
+// Skewed key popularity: a few hot keys, a long cold tail
+static void *
+worker(void *arg)
+{
+    unsigned long seed = (unsigned long)(size_t)arg + 1;
+    long checksum = 0;
+
+    for (int i = 0; i < OPS; i++) {
+        uint64_t id, hash;
+        double u;
+        long *entry;
+
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        u = (double)(seed >> 11) / 9007199254740992.0;
+        id = (uint64_t)(u * u * u * KEYS);
+        hash = mida_hash(&id, sizeof id);
+        if ((entry = mida_lru_get(&cache, hash, &id)) != NULL) {
+            checksum += entry[0];
+            mida_lru_release(&cache, entry);
+            continue;
+        }
+        // Miss: "decode" an entry of 64 to 4096 bytes and cache it
+        {
+            const size_t count = 8 + id % 505;
+            entry = mida_calloc(EntryMD, sizeof(long), count);
+            MIDA(EntryMD, entry)->id = id;
+            entry[0] = (long)id;
+            mida_lru_put(&cache, entry, hash, &id, count * sizeof(long));
+        }
+    }
+    return (void *)(size_t)checksum;
+}
+
+int
+main()
+{
+    pthread_t threads[THREADS];
+    size_t hits, misses, bytes;
+
+    for (int n = 1; n <= THREADS; n *= 2) {
+        double start;
+
+        mida_lru_init(&cache, EntryMD, node, BUDGET, entry_eq, entry_evict,
+                      NULL);
+        start = now();
+        for (int t = 0; t < n; t++)
+            pthread_create(&threads[t], NULL, worker, (void *)(size_t)t);
+        for (int t = 0; t < n; t++)
+            pthread_join(threads[t], NULL);
+        mida_lru_stats(&cache, &hits, &misses, &bytes);
+        printf("%d thread(s): %6.2f Mops/s, hit rate %5.1f%%, %5.1f MiB\n", n,
+               (double)(hits + misses) / (now() - start) / 1e6,
+               100.0 * (double)hits / (double)(hits + misses),
+               (double)bytes / (1 << 20));
+        mida_lru_cleanup(&cache);
+    }
+    return 0;
+}
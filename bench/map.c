@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "../mida.h"
+
+#define OBJECTS 1000000
+
+typedef struct record_metadata {
+    struct mida_hnode link;
+    uint64_t id;
+} RecordMD;
+
+// Conventional chained map, with a separately allocated node per entry
+struct node {
+    struct node *next;
+    uint64_t key;
+    void *value;
+};
+
+struct chained_map {
+    struct node **buckets;
+    size_t mask;
+};
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    return x ^ (x >> 33);
+}
+
+static void
+chained_insert(struct chained_map *map, uint64_t key, void *value)
+{
+    struct node *node = malloc(sizeof *node);
+    struct node **bucket = &map->buckets[mix(key) & map->mask];
+    node->key = key;
+    node->value = value;
+    node->next = *bucket;
+    *bucket = node;
+}
+
+static void *
+chained_find(const struct chained_map *map, uint64_t key)
+{
+    struct node *node = map->buckets[mix(key) & map->mask];
+    for (; node; node = node->next)
+        if (node->key == key) return node->value;
+    return NULL;
+}
+
+static int
+record_eq(const void *base, const void *key)
+{
+    return MIDA(RecordMD, base)->id == *(const uint64_t *)key;
+}
+
+int
+main()
+{
+    static double *records[OBJECTS];
+    static uint64_t order[OBJECTS];
+    struct chained_map chained;
+    struct mida_map map;
+    unsigned long seed = 42;
+    long found = 0;
+    double start;
+
+    for (size_t i = 0; i < OBJECTS; i++) {
+        records[i] = mida_malloc(RecordMD, sizeof(double), 4);
+        MIDA(RecordMD, records[i])->id = i;
+        records[i][0] = (double)i;
+        order[i] = i;
+    }
+    for (size_t i = OBJECTS - 1; i > 0; i--) {
+        uint64_t tmp;
+        size_t j;
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        j = (size_t)(seed >> 33) % (i + 1);
+        tmp = order[i], order[i] = order[j], order[j] = tmp;
+    }
+
+    // Both maps sized alike: the chained one up front, mida_map by growing
+    chained.mask = (1 << 20) - 1;
+    chained.buckets = calloc(chained.mask + 1, sizeof *chained.buckets);
+    start = now();
+    for (size_t i = 0; i < OBJECTS; i++)
+        chained_insert(&chained, i, records[i]);
+    printf("chained map insert:  %6.2f ns/op\n",
+           (now() - start) * 1e9 / OBJECTS);
+
+    mida_map_init(&map, RecordMD, link, record_eq);
+    start = now();
+    for (size_t i = 0; i < OBJECTS; i++)
+        mida_map_insert(&map, records[i], mix(i));
+    printf("mida_map insert:     %6.2f ns/op\n",
+           (now() - start) * 1e9 / OBJECTS);
+
+    start = now();
+    for (size_t i = 0; i < OBJECTS; i++) {
+        double *record = chained_find(&chained, order[i]);
+        found += record[0] == (double)order[i];
+    }
+    printf("chained map lookup:  %6.2f ns/op\n",
+           (now() - start) * 1e9 / OBJECTS);
+
+    start = now();
+    for (size_t i = 0; i < OBJECTS; i++) {
+        double *record = mida_map_find(&map, mix(order[i]), &order[i]);
+        found -= record[0] == (double)order[i];
+    }
+    printf("mida_map lookup:     %6.2f ns/op\n",
+           (now() - start) * 1e9 / OBJECTS);
+
+    for (size_t i = 0; i <= chained.mask; i++) {
+        struct node *node = chained.buckets[i], *next;
+        for (; node; node = next) {
+            next = node->next;
+            free(node);
+        }
+    }
+    free(chained.buckets);
+    mida_map_cleanup(&map);
+    for (size_t i = 0; i < OBJECTS; i++)
+        mida_free(RecordMD, records[i]);
+    return found != 0;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define VALUES 10000000
+#define BATCH 4096
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+run(const char *name, const int64_t *values)
+{
+    static int64_t batch[BATCH];
+    struct mida_pack_iter iter;
+    uint64_t *packed;
+    int64_t plain = 0, decoded = 0, iterated = 0, got = 0, value;
+    unsigned long seed = 42;
+    double start;
+
+    printf("%s:\n", name);
+    start = now();
+    packed = mida_pack(values, VALUES);
+    printf("  encode:            %6.2f ns/value\n",
+           (now() - start) * 1e9 / VALUES);
+    printf("  size:              %6.2f bits/value\n",
+           MIDA(struct mida_packed, packed)->words * 64.0 / VALUES);
+
+    start = now();
+    for (size_t i = 0; i < VALUES; i++)
+        plain += values[i];
+    printf("  plain scan:        %6.2f ns/value\n",
+           (now() - start) * 1e9 / VALUES);
+
+    start = now();
+    for (size_t i = 0; i < VALUES; i += BATCH) {
+        const size_t n = mida_pack_decode(packed, i, BATCH, batch);
+        for (size_t j = 0; j < n; j++)
+            decoded += batch[j];
+    }
+    printf("  decode + scan:     %6.2f ns/value\n",
+           (now() - start) * 1e9 / VALUES);
+
+    start = now();
+    mida_pack_iter_init(&iter, packed);
+    while (mida_pack_iter_next(&iter, &value))
+        iterated += value;
+    printf("  iterator:          %6.2f ns/value\n",
+           (now() - start) * 1e9 / VALUES);
+
+    start = now();
+    for (int i = 0; i < 1000000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        got += mida_pack_get(packed, (seed >> 33) % VALUES);
+    }
+    printf("  random get:        %6.2f ns\n", (now() - start) * 1e3);
+
+    if (plain != decoded || plain != iterated || !got)
+        printf("  MISMATCH\n");
+    mida_pack_free(packed);
+}
+
+int
+main()
+{
+    int64_t *values = malloc(VALUES * sizeof *values);
+    unsigned long seed = 42;
+
+    if (!values) return 1;
+    // Event times in microseconds, about 1ms apart
+    values[0] = 1700000000000000L;
+    for (int i = 1; i < VALUES; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        values[i] = values[i - 1] + 1000 + (int64_t)(seed >> 56);
+    }
+    run("timestamps", values);
+
+    // Ids below one million, in no order
+    for (int i = 0; i < VALUES; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        values[i] = (int64_t)(seed >> 33) % 1000000;
+    }
+    run("ids", values);
+
+    free(values);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "../mida.h"
+
+#define ELEMENTS 100000000UL
+#define ROUNDS 3
+
+typedef struct column_metadata {
+    size_t length;
+} ColumnMD;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+transform(void *base, size_t first, size_t last, void *context)
+{
+    double *values = base;
+
+    (void)context;
+    for (size_t i = first; i < last; i++)
+        values[i] = values[i] * 1.5 + 1.0;
+}
+
+static void
+sum(void *base, size_t first, size_t last, void *partial, void *context)
+{
+    const double *values = base;
+    double total = 0;
+
+    (void)context;
+    for (size_t i = first; i < last; i++)
+        total += values[i];
+    *(double *)partial += total;
+}
+
+static void
+sum_combine(void *result, const void *partial, void *context)
+{
+    (void)context;
+    *(double *)result += *(const double *)partial;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const size_t elements = argc > 1 ? strtoul(argv[1], NULL, 10) : ELEMENTS;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double *values = mida_malloc(ColumnMD, sizeof *values, elements);
+    double start, total, serial = 0;
+
+    if (!values) return EXIT_FAILURE;
+    MIDA(ColumnMD, values)->length = elements;
+    for (size_t i = 0; i < elements; i++)
+        values[i] = (double)(i % 1000);
+
+    printf("%zu elements, %ld online CPUs\n", elements, cpus);
+    if (cpus < 4) cpus = 4;
+    for (unsigned threads = 1; threads <= (unsigned)cpus; threads *= 2) {
+        double transform_time = 0, sum_time = 0;
+
+        mida_parallel_start(threads);
+        for (int r = 0; r < ROUNDS; r++) {
+            start = now();
+            mida_parallel_for(ColumnMD, values, 0, transform, NULL);
+            transform_time += now() - start;
+
+            total = 0;
+            start = now();
+            mida_parallel_reduce(ColumnMD, values, 0, &total, sum,
+                                 sum_combine, NULL);
+            sum_time += now() - start;
+        }
+        mida_parallel_stop();
+        if (threads == 1) serial = sum_time;
+        printf("%2u threads: transform %7.2f ms, sum %7.2f ms (%.2fx)\n",
+               threads, transform_time * 1e3 / ROUNDS,
+               sum_time * 1e3 / ROUNDS, serial / sum_time);
+    }
+    mida_free(ColumnMD, values);
+    return total > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define NODES 1000000
+#define ROUNDS 5
+
+typedef struct node_metadata {
+    size_t length;
+} NodeMD;
+
+struct node {
+    struct node *next;
+    long payload[15];
+};
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long
+visit(const struct node *node)
+{
+    long sum = (long)MIDA(NodeMD, node)->length;
+    for (int i = 0; i < 15; i++)
+        sum += node->payload[i];
+    return sum;
+}
+
+static long
+walk_plain(struct node *head)
+{
+    long sum = 0;
+    for (; head; head = head->next)
+        sum += visit(head);
+    return sum;
+}
+
+static long
+walk_prefetch_next(struct node *head)
+{
+    long sum = 0;
+    for (; head; head = head->next) {
+        if (head->next) mida_prefetch(NodeMD, head->next);
+        sum += visit(head);
+    }
+    return sum;
+}
+
+static long
+walk_iterator(struct node *head, size_t depth)
+{
+    struct mida_walk walk;
+    struct node *node;
+    long sum = 0;
+
+    mida_walk_init(&walk, NodeMD, head, struct node, next, depth);
+    while ((node = mida_walk_next(&walk)) != NULL)
+        sum += visit(node);
+    return sum;
+}
+
+int
+main()
+{
+    static struct node *nodes[NODES];
+    unsigned long seed = 42;
+    double start;
+    long check, sum;
+
+    for (size_t i = 0; i < NODES; i++) {
+        nodes[i] = mida_malloc(NodeMD, sizeof(struct node), 1);
+        MIDA(NodeMD, nodes[i])->length = 1;
+        for (int j = 0; j < 15; j++)
+            nodes[i]->payload[j] = (long)i + j;
+    }
+    // Link the nodes in a random order, so that every hop is a cache miss
+    for (size_t i = NODES - 1; i > 0; i--) {
+        struct node *tmp;
+        size_t j;
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        j = (size_t)(seed >> 33) % (i + 1);
+        tmp = nodes[i], nodes[i] = nodes[j], nodes[j] = tmp;
+    }
+    for (size_t i = 0; i < NODES; i++)
+        nodes[i]->next = i + 1 < NODES ? nodes[i + 1] : NULL;
+
+    check = walk_plain(nodes[0]);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sum = walk_plain(nodes[0]);
+    printf("plain walk:           %6.2f ns/node\n",
+           (now() - start) * 1e9 / (ROUNDS * NODES));
+    if (sum != check) return 1;
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sum = walk_prefetch_next(nodes[0]);
+    printf("mida_prefetch() next: %6.2f ns/node\n",
+           (now() - start) * 1e9 / (ROUNDS * NODES));
+    if (sum != check) return 1;
+
+    for (size_t depth = 2; depth <= MIDA_WALK_MAX; depth *= 2) {
+        start = now();
+        for (int r = 0; r < ROUNDS; r++)
+            sum = walk_iterator(nodes[0], depth);
+        printf("mida_walk depth %-4zu  %6.2f ns/node\n", depth,
+               (now() - start) * 1e9 / (ROUNDS * NODES));
+        if (sum != check) return 1;
+    }
+
+    for (size_t i = 0; i < NODES; i++)
+        mida_free(NodeMD, nodes[i]);
+    return 0;
+}
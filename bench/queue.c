@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define ITEMS_PER_THREAD 1000000
+
+typedef struct item_metadata {
+    size_t id;
+} ItemMD;
+
+// Baseline queue protected by a mutex
+struct locked_queue {
+    pthread_mutex_t lock;
+    void **cells;
+    size_t head, tail, mask;
+};
+
+struct worker {
+    void *q;
+    int kind;
+    int *items;
+};
+
+enum { KIND_LOCKED, KIND_MPMC, KIND_SPSC };
+
+static int
+locked_push(struct locked_queue *q, void *p)
+{
+    int ret = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail - q->head <= q->mask) {
+        q->cells[q->tail++ & q->mask] = p;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+static void *
+locked_pop(struct locked_queue *q)
+{
+    void *p = NULL;
+    pthread_mutex_lock(&q->lock);
+    if (q->head != q->tail) p = q->cells[q->head++ & q->mask];
+    pthread_mutex_unlock(&q->lock);
+    return p;
+}
+
+static int
+push(struct worker *w, void *p)
+{
+    switch (w->kind) {
+    case KIND_MPMC:
+        return mida_mpmc_push(w->q, p);
+    case KIND_SPSC:
+        return mida_spsc_push(w->q, p);
+    default:
+        return locked_push(w->q, p);
+    }
+}
+
+static void *
+pop(struct worker *w)
+{
+    switch (w->kind) {
+    case KIND_MPMC:
+        return mida_mpmc_pop(w->q);
+    case KIND_SPSC:
+        return mida_spsc_pop(w->q);
+    default:
+        return locked_pop(w->q);
+    }
+}
+
+static void *
+producer(void *arg)
+{
+    struct worker *w = arg;
+    for (size_t i = 0; i < ITEMS_PER_THREAD; i++) {
+        while (push(w, w->items + i) != 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *
+consumer(void *arg)
+{
+    struct worker *w = arg;
+    for (size_t i = 0; i < ITEMS_PER_THREAD; i++) {
+        while (!pop(w))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+run(const char *name, int kind, void *q, int pairs, int *items)
+{
+    pthread_t threads[2 * 8];
+    struct worker workers[2 * 8];
+    double start = now(), elapsed;
+
+    for (int i = 0; i < 2 * pairs; i++) {
+        workers[i] = (struct worker){ q, kind, items };
+        pthread_create(&threads[i], NULL, i % 2 ? consumer : producer,
+                       &workers[i]);
+    }
+    for (int i = 0; i < 2 * pairs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = now() - start;
+    printf("%-8s %2d producers %2d consumers: %8.2f Mops/s\n", name, pairs,
+           pairs, (double)pairs * ITEMS_PER_THREAD / elapsed / 1e6);
+}
+
+int
+main()
+{
+    int *items = mida_malloc(ItemMD, sizeof(int), ITEMS_PER_THREAD);
+    MIDA(ItemMD, items)->id = 0;
+
+    for (int pairs = 1; pairs <= 8; pairs *= 2) {
+        struct locked_queue locked = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0,
+                                       1023 };
+        struct mida_mpmc mpmc;
+
+        locked.cells = malloc(1024 * sizeof(void *));
+        run("mutex", KIND_LOCKED, &locked, pairs, items);
+        free(locked.cells);
+
+        mida_mpmc_init(&mpmc, 1024);
+        run("mpmc", KIND_MPMC, &mpmc, pairs, items);
+        mida_mpmc_cleanup(&mpmc);
+    }
+
+    struct mida_spsc spsc;
+    mida_spsc_init(&spsc, 1024);
+    run("spsc", KIND_SPSC, &spsc, 1, items);
+    mida_spsc_cleanup(&spsc);
+
+    mida_free(ItemMD, items);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <time.h>
+#include "../mida.h"
+
+#define BUFFERS 2048
+#define LOOKUPS 50000000
+
+typedef struct buffer_metadata {
+    size_t length;
+} BufferMD;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int
+main()
+{
+    static char *inline_buffers[BUFFERS], *foreign_buffers[BUFFERS];
+    static BufferMD foreign_metas[BUFFERS];
+    size_t sum = 0;
+    double start;
+
+    for (size_t i = 0; i < BUFFERS; i++) {
+        inline_buffers[i] = mida_malloc(BufferMD, 1, 64);
+        MIDA(BufferMD, inline_buffers[i])->length = i;
+        foreign_buffers[i] = malloc(64);
+        foreign_metas[i].length = i;
+        mida_attach(foreign_buffers[i], &foreign_metas[i]);
+    }
+
+    start = now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        sum += MIDA(BufferMD, inline_buffers[(i * 7919) % BUFFERS])->length;
+    }
+    printf("inline MIDA(): %6.2f ns/lookup\n",
+           (now() - start) / LOOKUPS * 1e9);
+
+    start = now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        sum += MIDA_LOOKUP(BufferMD, foreign_buffers[(i * 7919) % BUFFERS])
+                   ->length;
+    }
+    printf("mida_lookup(): %6.2f ns/lookup\n",
+           (now() - start) / LOOKUPS * 1e9);
+
+    for (size_t i = 0; i < BUFFERS; i++) {
+        mida_detach(foreign_buffers[i]);
+        free(foreign_buffers[i]);
+        mida_free(BufferMD, inline_buffers[i]);
+    }
+    return sum == 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../mida.h"
+
+#define LINES 20000
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Formats into a scratch buffer and concatenates with strlen() + strcpy(),
+// reallocating to the exact size on every line
+static size_t
+build_snprintf(void)
+{
+    char line[128], *log = calloc(1, 1);
+    size_t length;
+
+    for (int i = 0; i < LINES; i++) {
+        snprintf(line, sizeof line, "[%05d] GET /index.html %d\n", i,
+                 200 + i % 3);
+        log = realloc(log, strlen(log) + strlen(line) + 1);
+        strcpy(log + strlen(log), line);
+    }
+    length = strlen(log);
+    free(log);
+    return length;
+}
+
+static size_t
+build_appendf(void)
+{
+    char *log = mida_str_new(NULL);
+    size_t length;
+
+    for (int i = 0; i < LINES; i++)
+        mida_str_appendf(&log, "[%05d] GET /index.html %d\n", i,
+                         200 + i % 3);
+    length = MIDA(struct mida_str, log)->length;
+    mida_str_free(log);
+    return length;
+}
+
+static size_t
+build_append(void)
+{
+    char line[128], *log = mida_str_new(NULL);
+    size_t length;
+
+    for (int i = 0; i < LINES; i++) {
+        int n = snprintf(line, sizeof line, "[%05d] GET /index.html %d\n", i,
+                         200 + i % 3);
+        mida_str_appendn(&log, line, (size_t)n);
+    }
+    length = MIDA(struct mida_str, log)->length;
+    mida_str_free(log);
+    return length;
+}
+
+int
+main()
+{
+    size_t expected, length;
+    double start;
+
+    start = now();
+    expected = build_snprintf();
+    printf("snprintf + strcpy:      %8.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    length = build_appendf();
+    printf("mida_str_appendf():     %8.2f ms\n", (now() - start) * 1e3);
+    if (length != expected) return 1;
+
+    start = now();
+    length = build_append();
+    printf("mida_str_appendn():     %8.2f ms\n", (now() - start) * 1e3);
+    return length != expected;
+}
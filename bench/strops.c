@@ -0,0 +1,96 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../mida.h"
+
+#define LENGTH 4096
+#define ROUNDS 100000
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double start)
+{
+    printf("%-28s %8.2f ns/op\n", name, (now() - start) * 1e9 / ROUNDS);
+}
+
+int
+main()
+{
+    char *a = mida_str_new(NULL), *b, *lower;
+    volatile long sink = 0;
+    double start;
+
+    // Lowercase text with a needle and separators only near the end
+    for (int i = 0; i < LENGTH; i++)
+        mida_str_appendn(&a, &"etaoin shrdlu"[i % 13], 1);
+    memcpy(a + LENGTH - 32, "Needle;in|haystack", 18);
+    b = mida_str_new(a);
+    lower = mida_str_new(a);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += strcmp(a, b) == 0;
+    report("strcmp() == 0", start);
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += mida_str_equals(a, b);
+    report("mida_str_equals()", start);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += strstr(a, "Needle") != NULL;
+    report("strstr()", start);
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += mida_str_find(a, "Needle", 6) != NULL;
+    report("mida_str_find()", start);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += strpbrk(a, ";|") != NULL;
+    report("strpbrk()", start);
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += mida_str_find_any(a, ";|") != NULL;
+    report("mida_str_find_any()", start);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (char *p = lower; *p; p++)
+            *p = (char)tolower((unsigned char)*p);
+    report("tolower() loop", start);
+    start = now();
+    for (int r = 0; r < ROUNDS; r++)
+        mida_str_to_lower(lower);
+    report("mida_str_to_lower()", start);
+
+    start = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        const char *p = a, *q;
+        long count = 1;
+        while ((q = strchr(p, ' ')) != NULL)
+            p = q + 1, ++count;
+        sink += count;
+    }
+    report("strchr() split count", start);
+    start = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        struct mida_slice *slices = mida_str_split(a, ' ');
+        sink += (long)MIDA(struct mida_str, slices)->length;
+        mida_free(struct mida_str, slices);
+    }
+    report("mida_str_split()", start);
+
+    mida_str_free(a);
+    mida_str_free(b);
+    mida_str_free(lower);
+    return sink == 0;
+}
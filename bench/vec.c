@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../mida.h"
+
+#define PUSHES 10000000
+#define SORTED 1000000
+
+typedef struct vec_metadata {
+    size_t length;
+    size_t capacity;
+} VecMD;
+
+MIDA_DEFINE_VEC(int_vec, VecMD, int)
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Generic push, with the element size known only at runtime
+static __attribute__((noinline)) int
+generic_push(void **p_vec, const void *element, size_t size)
+{
+    VecMD *md = *p_vec ? MIDA(VecMD, *p_vec) : NULL;
+    size_t length = md ? md->length : 0, capacity = md ? md->capacity : 0;
+
+    if (length == capacity) {
+        void *vec;
+        capacity = capacity ? capacity * 2 : 8;
+        if (!(vec = mida_realloc(VecMD, *p_vec, size, capacity))) return -1;
+        *p_vec = vec;
+        MIDA(VecMD, vec)->length = length;
+        MIDA(VecMD, vec)->capacity = capacity;
+    }
+    memcpy((char *)*p_vec + length * size, element, size);
+    MIDA(VecMD, *p_vec)->length = length + 1;
+    return 0;
+}
+
+// Hand-written typed array
+struct int_array {
+    int *data;
+    size_t length, capacity;
+};
+
+static void
+array_push(struct int_array *array, int value)
+{
+    if (array->length == array->capacity) {
+        array->capacity = array->capacity ? array->capacity * 2 : 8;
+        array->data =
+            realloc(array->data, array->capacity * sizeof *array->data);
+    }
+    array->data[array->length++] = value;
+}
+
+static int
+int_cmp(const int *a, const int *b)
+{
+    return (*a > *b) - (*a < *b);
+}
+
+static int
+qsort_cmp(const void *a, const void *b)
+{
+    return int_cmp(a, b);
+}
+
+int
+main()
+{
+    struct int_array array = { NULL, 0, 0 };
+    int *generic = NULL, *typed = NULL, *copy;
+    unsigned long seed = 42;
+    double start;
+    long check = 0;
+
+    start = now();
+    for (int i = 0; i < PUSHES; i++)
+        generic_push((void **)&generic, &i, sizeof i);
+    printf("generic push:          %6.2f ns/op\n",
+           (now() - start) * 1e9 / PUSHES);
+
+    start = now();
+    for (int i = 0; i < PUSHES; i++)
+        int_vec_push(&typed, i);
+    printf("MIDA_DEFINE_VEC push:  %6.2f ns/op\n",
+           (now() - start) * 1e9 / PUSHES);
+
+    start = now();
+    for (int i = 0; i < PUSHES; i++)
+        array_push(&array, i);
+    printf("hand-written push:     %6.2f ns/op\n",
+           (now() - start) * 1e9 / PUSHES);
+
+    for (int i = 0; i < SORTED; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        typed[i] = (int)(seed >> 33);
+    }
+    int_vec_resize(&typed, SORTED);
+    copy = int_vec_new(SORTED);
+    memcpy(copy, typed, SORTED * sizeof *copy);
+
+    start = now();
+    qsort(copy, SORTED, sizeof *copy, qsort_cmp);
+    printf("qsort():               %6.2f ms\n", (now() - start) * 1e3);
+
+    start = now();
+    int_vec_sort(typed, int_cmp);
+    printf("MIDA_DEFINE_VEC sort:  %6.2f ms\n", (now() - start) * 1e3);
+
+    for (int i = 0; i < SORTED; i++)
+        check += typed[i] != copy[i];
+    for (size_t i = 0; i < array.length; i++)
+        check += generic[i] != array.data[i];
+
+    free(array.data);
+    mida_free(VecMD, generic);
+    int_vec_free(typed);
+    int_vec_free(copy);
+    return check != 0;
+}
@@ -4,10 +4,6 @@
 #include "../mida.h"
 
 // Different metadata for different levels
-typedef struct string_metadata {
-    size_t length;
-} StrMD;
-
 typedef struct array_metadata {
     size_t count;
     char description[64];
@@ -36,11 +32,11 @@ main()
     strcpy(doc_meta->type, "Report");
     doc_meta->id = 101;
 
-    // Create title with string metadata
-    doc->title = mida_malloc(StrMD, sizeof(char), 22);
-    strcpy(doc->title, "Annual Financial Report");
-    StrMD *title_meta = MIDA(StrMD, doc->title);
-    title_meta->length = strlen(doc->title);
+    // Create title with string metadata, built piece by piece
+    doc->title = mida_str_new("Annual");
+    mida_str_append(&doc->title, " Financial");
+    mida_str_appendf(&doc->title, " %s", "Report");
+    struct mida_str *title_meta = MIDA(struct mida_str, doc->title);
 
     // Create page lengths array with array metadata
     doc->page_lengths = mida_malloc(ArrayMD, sizeof(int), 5);
@@ -62,10 +58,9 @@ main()
     related_meta->id = 102;
 
     // Create title for related document
-    doc->related_doc->title = mida_malloc(StrMD, sizeof(char), 25);
-    strcpy(doc->related_doc->title, "Financial Report Appendix");
-    StrMD *rel_title_meta = MIDA(StrMD, doc->related_doc->title);
-    rel_title_meta->length = strlen(doc->related_doc->title);
+    doc->related_doc->title = mida_str_new("Financial Report Appendix");
+    struct mida_str *rel_title_meta =
+        MIDA(struct mida_str, doc->related_doc->title);
 
     // No pages or related docs for the appendix
     doc->related_doc->page_lengths = NULL;
@@ -97,10 +92,10 @@ main()
            rel_title_meta->length);
 
     // Free all allocated memory
-    mida_free(StrMD, doc->related_doc->title);
+    mida_str_free(doc->related_doc->title);
     mida_free(ObjMD, doc->related_doc);
     mida_free(ArrayMD, doc->page_lengths);
-    mida_free(StrMD, doc->title);
+    mida_str_free(doc->title);
     mida_free(ObjMD, doc);
 
     return 0;
@@ -7,11 +7,30 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #if __STDC_VERSION__ && __STDC_VERSION__ >= 199901L
 #define MIDA_WITH_C99
 #endif /* __STDC_VERSION__ */
 
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define MIDA_WITH_POSIX
+#endif /* __unix__ */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MIDA_WITH_ATOMICS
+#endif /* __GNUC__ */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(__SSE2__)                          \
+    && (defined(__x86_64__) || defined(__i386__))
+#define MIDA_WITH_SSE2
+#endif /* __SSE2__ */
+
+#ifndef MIDA_CACHELINE
+#define MIDA_CACHELINE 64
+#endif /* MIDA_CACHELINE */
+
 #ifdef MIDA_STATIC
 #define MIDA_API static
 #else
@@ -224,76 +243,6956 @@ MIDA_API void *__mida_nwrap(const size_t container_size,
 #define MIDA(_container, _base)                                               \
     ((_container *)((mida_byte *)(_base) - sizeof(_container)))
 
-#ifndef MIDA_HEADER
+#ifdef MIDA_WITH_POSIX
 
-#include <string.h>
-#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
 
-#define __mida_data_from_container(_container_ptr, _container_size)           \
-    ((mida_byte *)_container_ptr + _container_size)
-#define __mida_container_from_data(_data_ptr, _container_size)                \
-    (void *)((mida_byte *)_data_ptr - _container_size)
+#ifndef MIDA_IOV_MAX
+#define MIDA_IOV_MAX 1024
+#endif /* MIDA_IOV_MAX */
 
-MIDA_API void *
-__mida_malloc(const size_t container_size,
-              const size_t element_size,
-              const size_t count)
-{
-    const size_t data_size = element_size * count,
-                 total_size = container_size + data_size;
-    mida_byte *container = malloc(total_size);
-    return !container ? NULL
-                      : __mida_data_from_container(container, container_size);
-}
+/**
+ * @struct mida_chain
+ * @brief Scatter-gather chain of MIDA segments
+ *
+ * Keeps an iovec deque pointing straight at the data of each segment, so
+ * segments keep their own metadata and the chain can be flushed with
+ * writev() or sendmsg() without concatenating them first. The chain never
+ * owns the segments it references.
+ */
+struct mida_chain {
+    /** iovec storage, entries in use are [head, head + count) */
+    struct iovec *iov;
+    /** index of the first entry in use */
+    size_t head;
+    /** number of entries in use */
+    size_t count;
+    /** number of entries allocated */
+    size_t capacity;
+    /** total amount of bytes referenced by the chain */
+    size_t length;
+};
 
-MIDA_API void *
-__mida_calloc(const size_t container_size,
-              const size_t element_size,
-              const size_t count)
-{
-    const size_t data_size = element_size * count,
-                 total_size = container_size + data_size;
-    mida_byte *container = calloc(1, total_size);
-    return !container ? NULL
-                      : __mida_data_from_container(container, container_size);
-}
+/**
+ * @brief Initializes an empty chain
+ *
+ * @param chain The chain to be initialized
+ */
+MIDA_API void mida_chain_init(struct mida_chain *chain);
 
-MIDA_API void *
-__mida_realloc(const size_t container_size,
-               void *base,
-               const size_t element_size,
-               const size_t count)
-{
-    if (base) {
-        const size_t data_size = element_size * count,
-                     total_size = container_size + data_size;
-        mida_byte *original_container =
-            __mida_container_from_data(base, container_size);
-        mida_byte *container = realloc(original_container, total_size);
-        return !container
-                   ? NULL
-                   : __mida_data_from_container(container, container_size);
-    }
-    return __mida_malloc(container_size, element_size, count);
-}
+/**
+ * @brief Releases the chain storage (but not the segments)
+ *
+ * @param chain The chain to be cleaned up
+ */
+MIDA_API void mida_chain_cleanup(struct mida_chain *chain);
 
-MIDA_API void *
-__mida_nwrap(const size_t container_size,
-             void *data,
-             const size_t size,
-             mida_byte *const container)
-{
-    return memcpy(__mida_data_from_container(container, container_size), data,
-                  size);
-}
+/**
+ * @brief Appends a segment to the end of the chain in amortized O(1)
+ *
+ * @param chain The chain
+ * @param base Pointer to the segment data (not the container)
+ * @param size Amount of bytes of the segment to be sent
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_chain_append(struct mida_chain *chain,
+                               const void *base,
+                               const size_t size);
 
-#undef _mida_data_from_container
-#undef _mida_container_from_data
+/**
+ * @brief Prepends a segment to the start of the chain in amortized O(1)
+ *
+ * @param chain The chain
+ * @param base Pointer to the segment data (not the container)
+ * @param size Amount of bytes of the segment to be sent
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_chain_prepend(struct mida_chain *chain,
+                                const void *base,
+                                const size_t size);
 
-#endif /* MIDA_HEADER */
+/**
+ * @brief Drops the first `size` bytes of the chain
+ *
+ * Fully consumed segments are removed, a partially consumed one is
+ * advanced in place.
+ *
+ * @param chain The chain
+ * @param size Amount of bytes to be consumed
+ */
+MIDA_API void mida_chain_consume(struct mida_chain *chain, size_t size);
 
-#ifdef __cplusplus
-}
+/**
+ * @brief Gets the iovec array of the chain
+ *
+ * @param chain The chain
+ * @param iovcnt Set to the amount of entries in the returned array
+ * @return The iovec array, valid until the chain is modified
+ */
+MIDA_API const struct iovec *mida_chain_iov(const struct mida_chain *chain,
+                                            int *iovcnt);
+
+/**
+ * @brief Writes the chain with a single writev() call
+ *
+ * Written bytes are consumed from the chain, call it again while
+ * `chain->length` is not zero to complete a partial write.
+ *
+ * @param chain The chain
+ * @param fd The file descriptor to write to
+ * @return Amount of bytes written, or -1 with errno set
+ */
+MIDA_API ssize_t mida_chain_writev(struct mida_chain *chain, int fd);
+
+/**
+ * @brief Sends the chain with a single sendmsg() call
+ *
+ * Sent bytes are consumed from the chain, call it again while
+ * `chain->length` is not zero to complete a partial send.
+ *
+ * @param chain The chain
+ * @param fd The socket to send to
+ * @param flags Flags forwarded to sendmsg()
+ * @return Amount of bytes sent, or -1 with errno set
+ */
+MIDA_API ssize_t mida_chain_sendmsg(struct mida_chain *chain,
+                                    int fd,
+                                    int flags);
+
+#endif /* MIDA_WITH_POSIX */
+
+/**
+ * @struct mida_pkb
+ * @brief Container of a packet buffer with headroom and tailroom
+ *
+ * A packet buffer is handled through the start of its data window, the
+ * `length` bytes found `head` bytes into the `size` bytes long buffer. The
+ * container always sits right before the window, so MIDA() resolves it from
+ * the pointer of any layer. Layers may grow or shrink the window at both
+ * ends with mida_push(), mida_pull(), mida_put() and mida_trim() without
+ * reallocating or copying the data: moving its start only moves the
+ * container along, through the headroom. The pointer handed to mida_push(),
+ * mida_pull() and mida_pkb_reserve() is no longer valid afterwards, the
+ * returned one is to be used instead.
+ *
+ * As the window may start anywhere, the container is packed when the
+ * compiler supports it; otherwise the headroom and the sizes pushed and
+ * pulled must be multiples of the alignment of `size_t`.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define MIDA_PACKED __attribute__((packed))
+#else
+#define MIDA_PACKED
+#endif /* __GNUC__ */
+
+struct MIDA_PACKED mida_pkb {
+    /** offset of the data window from the start of the buffer */
+    size_t head;
+    /** amount of bytes in the data window */
+    size_t length;
+    /** total amount of bytes of the buffer */
+    size_t size;
+    /** user defined flags */
+    unsigned long flags;
+};
+
+/**
+ * @brief Allocates a packet buffer with an empty data window
+ *
+ * @param size Total amount of bytes of the buffer
+ * @param headroom Amount of bytes reserved before the data window
+ * @return Pointer to the data window (not the container), released with
+ *      mida_pkb_free()
+ */
+MIDA_API void *mida_pkb_malloc(const size_t size, const size_t headroom);
+
+/**
+ * @brief Frees a packet buffer
+ *
+ * @param data Pointer to the current data window, or NULL
+ */
+MIDA_API void mida_pkb_free(void *data);
+
+/**
+ * @def mida_headroom(_data)
+ * @brief Gets the amount of bytes available before the data window
+ */
+#define mida_headroom(_data) (MIDA(struct mida_pkb, _data)->head)
+
+/**
+ * @def mida_tailroom(_data)
+ * @brief Gets the amount of bytes available after the data window
+ */
+#define mida_tailroom(_data)                                                  \
+    (MIDA(struct mida_pkb, _data)->size - MIDA(struct mida_pkb, _data)->head \
+     - MIDA(struct mida_pkb, _data)->length)
+
+/**
+ * @brief Moves the start of an empty data window forward
+ *
+ * @param data Pointer to the data window
+ * @param size Amount of bytes to move the window by
+ * @return The new start of the data window, or NULL if the window is not
+ *      empty or lacks tailroom
+ */
+MIDA_API void *mida_pkb_reserve(void *data, const size_t size);
+
+/**
+ * @brief Grows the data window towards the headroom
+ *
+ * Used to prepend a protocol header to the current data.
+ *
+ * @param data Pointer to the data window
+ * @param size Amount of bytes to prepend
+ * @return The new start of the data window, or NULL if there's not enough
+ *      headroom
+ */
+MIDA_API void *mida_push(void *data, const size_t size);
+
+/**
+ * @brief Shrinks the data window from its start
+ *
+ * Used to strip a protocol header from the current data.
+ *
+ * @param data Pointer to the data window
+ * @param size Amount of bytes to strip
+ * @return The new start of the data window, or NULL if the window is smaller
+ *      than `size`
+ */
+MIDA_API void *mida_pull(void *data, const size_t size);
+
+/**
+ * @brief Grows the data window towards the tailroom
+ *
+ * @param data Pointer to the data window
+ * @param size Amount of bytes to append
+ * @return Pointer to the appended bytes, or NULL if there's not enough
+ *      tailroom
+ */
+MIDA_API void *mida_put(void *data, const size_t size);
+
+/**
+ * @brief Shrinks the data window from its end
+ *
+ * @param data Pointer to the data window
+ * @param length New length of the data window, ignored if not smaller
+ */
+MIDA_API void mida_trim(void *data, const size_t length);
+
+#ifdef MIDA_WITH_ATOMICS
+
+struct mida_mpmc_cell {
+    size_t seq;
+    void *data;
+};
+
+/**
+ * @struct mida_mpmc
+ * @brief Bounded lock-free multi-producer multi-consumer queue
+ *
+ * Ring of MIDA pointers where each cell carries a sequence number, so
+ * producers and consumers only contend on their own position counter.
+ * Cells are preallocated, enqueuing never allocates.
+ */
+struct mida_mpmc {
+    struct mida_mpmc_cell *cells;
+    size_t mask;
+    mida_byte __pad0[MIDA_CACHELINE];
+    size_t enqueue_pos;
+    mida_byte __pad1[MIDA_CACHELINE];
+    size_t dequeue_pos;
+    mida_byte __pad2[MIDA_CACHELINE];
+};
+
+/**
+ * @brief Initializes a MPMC queue
+ *
+ * @param q The queue to be initialized
+ * @param capacity Maximum amount of queued pointers, rounded up to a power
+ *      of two
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_mpmc_init(struct mida_mpmc *q, size_t capacity);
+
+/**
+ * @brief Releases the queue storage (but not the queued pointers)
+ *
+ * @param q The queue to be cleaned up
+ */
+MIDA_API void mida_mpmc_cleanup(struct mida_mpmc *q);
+
+/**
+ * @brief Enqueues a pointer, safe to call from any thread
+ *
+ * @param q The queue
+ * @param base Pointer to be enqueued, must not be NULL
+ * @return 0 on success, -1 if the queue is full
+ */
+MIDA_API int mida_mpmc_push(struct mida_mpmc *q, void *base);
+
+/**
+ * @brief Dequeues a pointer, safe to call from any thread
+ *
+ * @param q The queue
+ * @return The dequeued pointer, or NULL if the queue is empty
+ */
+MIDA_API void *mida_mpmc_pop(struct mida_mpmc *q);
+
+/**
+ * @struct mida_spsc
+ * @brief Bounded lock-free single-producer single-consumer queue
+ *
+ * Faster variant of struct mida_mpmc for a pipeline stage fed by exactly
+ * one thread, each side caches the other side's position to avoid sharing
+ * cache lines on every operation.
+ */
+struct mida_spsc {
+    void **cells;
+    size_t mask;
+    mida_byte __pad0[MIDA_CACHELINE];
+    size_t head;
+    size_t tail_cache;
+    mida_byte __pad1[MIDA_CACHELINE];
+    size_t tail;
+    size_t head_cache;
+    mida_byte __pad2[MIDA_CACHELINE];
+};
+
+/**
+ * @brief Initializes a SPSC queue
+ *
+ * @param q The queue to be initialized
+ * @param capacity Maximum amount of queued pointers, rounded up to a power
+ *      of two
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_spsc_init(struct mida_spsc *q, size_t capacity);
+
+/**
+ * @brief Releases the queue storage (but not the queued pointers)
+ *
+ * @param q The queue to be cleaned up
+ */
+MIDA_API void mida_spsc_cleanup(struct mida_spsc *q);
+
+/**
+ * @brief Enqueues a pointer, must only be called by the producer thread
+ *
+ * @param q The queue
+ * @param base Pointer to be enqueued, must not be NULL
+ * @return 0 on success, -1 if the queue is full
+ */
+MIDA_API int mida_spsc_push(struct mida_spsc *q, void *base);
+
+/**
+ * @brief Dequeues a pointer, must only be called by the consumer thread
+ *
+ * @param q The queue
+ * @return The dequeued pointer, or NULL if the queue is empty
+ */
+MIDA_API void *mida_spsc_pop(struct mida_spsc *q);
+
+/**
+ * @struct mida_qlink
+ * @brief Queue link to be embedded in a container
+ *
+ * Lets struct mida_mpsc chain MIDA objects through their own header, so an
+ * unbounded queue needs no node allocation.
+ */
+struct mida_qlink {
+    struct mida_qlink *next;
+};
+
+/**
+ * @struct mida_mpsc
+ * @brief Unbounded intrusive multi-producer single-consumer queue
+ *
+ * Enqueuing is wait-free. The queue holds a stub link, so it must not be
+ * moved after mida_mpsc_init().
+ */
+struct mida_mpsc {
+    struct mida_qlink *head;
+    mida_byte __pad0[MIDA_CACHELINE];
+    struct mida_qlink *tail;
+    struct mida_qlink stub;
+};
+
+/**
+ * @brief Initializes an intrusive MPSC queue
+ *
+ * @param q The queue to be initialized
+ */
+MIDA_API void mida_mpsc_init(struct mida_mpsc *q);
+
+MIDA_API void __mida_mpsc_push(struct mida_mpsc *q, struct mida_qlink *link);
+
+/**
+ * @def mida_mpsc_push(_q, _container, _field, _base)
+ * @brief Enqueues a MIDA object through the link in its container
+ *
+ * Safe to call from any thread.
+ *
+ * @param _q The queue
+ * @param _container Type of the container structure
+ * @param _field Name of the struct mida_qlink member of the container
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_mpsc_push(_q, _container, _field, _base)                         \
+    __mida_mpsc_push(_q, &MIDA(_container, _base)->_field)
+
+MIDA_API void *__mida_mpsc_pop(struct mida_mpsc *q,
+                               const size_t container_size,
+                               const size_t link_offset);
+
+/**
+ * @def mida_mpsc_pop(_q, _container, _field)
+ * @brief Dequeues a MIDA object
+ *
+ * Must only be called by the consumer thread.
+ *
+ * @param _q The queue
+ * @param _container Type of the container structure
+ * @param _field Name of the struct mida_qlink member of the container
+ * @return Pointer to the data (not the container), or NULL if the queue is
+ *      empty (or a producer is halfway through an enqueue)
+ */
+#define mida_mpsc_pop(_q, _container, _field)                                 \
+    __mida_mpsc_pop(_q, sizeof(_container), offsetof(_container, _field))
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifdef MIDA_WITH_ATOMICS
+
+#ifndef MIDA_POOL_MIN_SHIFT
+#define MIDA_POOL_MIN_SHIFT 12
+#endif /* MIDA_POOL_MIN_SHIFT */
+
+#ifndef MIDA_POOL_MAX_SHIFT
+#define MIDA_POOL_MAX_SHIFT 20
+#endif /* MIDA_POOL_MAX_SHIFT */
+
+#define MIDA_POOL_CLASSES (MIDA_POOL_MAX_SHIFT - MIDA_POOL_MIN_SHIFT + 1)
+
+/**
+ * @struct mida_pool
+ * @brief Size-classed recycling pool of I/O buffers
+ *
+ * Buffers are rounded up to a power of two between 2^MIDA_POOL_MIN_SHIFT and
+ * 2^MIDA_POOL_MAX_SHIFT bytes of data, and released buffers are kept in a
+ * per-class free list, so a warmed up pool serves allocations without
+ * touching the heap or faulting pages in. Safe to use from multiple threads.
+ */
+struct mida_pool {
+    struct mida_pool_class {
+        int lock;
+        void *idle;
+    } classes[MIDA_POOL_CLASSES];
+    /** maximum amount of bytes owned by the pool, 0 for unlimited */
+    size_t limit;
+    /** amount of bytes currently owned by the pool (idle or in use) */
+    size_t held;
+};
+
+/**
+ * @brief Initializes a buffer pool
+ *
+ * @param pool The pool to be initialized
+ * @param limit Maximum amount of bytes the pool may own, 0 for unlimited
+ */
+MIDA_API void mida_pool_init(struct mida_pool *pool, const size_t limit);
+
+/**
+ * @brief Releases the idle buffers of the pool
+ *
+ * Buffers still in use stay valid and accounted for in the limit, they may
+ * be returned with mida_pool_free() and released by a later cleanup.
+ *
+ * @param pool The pool to be cleaned up
+ */
+MIDA_API void mida_pool_cleanup(struct mida_pool *pool);
+
+MIDA_API void *__mida_pool_malloc(struct mida_pool *pool,
+                                  const size_t container_size,
+                                  const size_t size);
+
+/**
+ * @def mida_pool_malloc(_pool, _container, _size)
+ * @brief Gets a buffer with a zeroed container from the pool
+ *
+ * @param _pool The pool
+ * @param _container Type of the container structure
+ * @param _size Minimum amount of data bytes
+ * @return Pointer to the data (not the container), or NULL if `_size` is
+ *      larger than the biggest class or the pool limit would be exceeded
+ */
+#define mida_pool_malloc(_pool, _container, _size)                            \
+    __mida_pool_malloc(_pool, sizeof(_container), _size)
+
+MIDA_API void __mida_pool_free(struct mida_pool *pool,
+                               const size_t container_size,
+                               void *base);
+
+/**
+ * @def mida_pool_free(_pool, _container, _base)
+ * @brief Returns a buffer to the pool for recycling
+ *
+ * @param _pool The pool the buffer was taken from
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_pool_free(_pool, _container, _base)                              \
+    __mida_pool_free(_pool, sizeof(_container), _base)
+
+MIDA_API size_t __mida_pool_capacity(const size_t container_size,
+                                     const void *base);
+
+/**
+ * @def mida_pool_capacity(_container, _base)
+ * @brief Gets the amount of data bytes usable in a pool buffer
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_pool_capacity(_container, _base)                                 \
+    __mida_pool_capacity(sizeof(_container), _base)
+
+MIDA_API int __mida_pool_prefill(struct mida_pool *pool,
+                                 const size_t container_size,
+                                 const size_t size,
+                                 size_t count);
+
+/**
+ * @def mida_pool_prefill(_pool, _container, _size, _count)
+ * @brief Populates the pool with idle buffers with their pages faulted in
+ *
+ * @param _pool The pool
+ * @param _container Type of the container structure
+ * @param _size Minimum amount of data bytes of each buffer
+ * @param _count Amount of buffers to add
+ * @return 0 on success, -1 if the limit was reached or allocation failed
+ */
+#define mida_pool_prefill(_pool, _container, _size, _count)                   \
+    __mida_pool_prefill(_pool, sizeof(_container), _size, _count)
+
+/**
+ * @brief Lets the kernel reclaim the pages of idle buffers
+ *
+ * Uses MADV_FREE (or MADV_DONTNEED) where available, buffers remain in the
+ * pool and are only faulted in again if the kernel did reclaim them.
+ *
+ * @param pool The pool
+ * @return Amount of bytes advised
+ */
+MIDA_API size_t mida_pool_trim(struct mida_pool *pool);
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+MIDA_API void __mida_free_deferred(void *container);
+
+/**
+ * @def mida_free_deferred(_container, _base)
+ * @brief Defers freeing memory for an array with extended metadata
+ *
+ * Pushes the block to a lock-free list owned by the calling thread, the
+ * actual free() happens later in mida_reclaim() or in the background
+ * reclaimer thread, keeping it out of latency critical paths. The block is
+ * linked through its first bytes, so it must be at least pointer sized.
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_free_deferred(_container, _base)                                 \
+    __mida_free_deferred(MIDA(_container, _base))
+
+/**
+ * @brief Frees every block deferred so far, by any thread
+ *
+ * Meant to be called at quiescent points when no reclaimer thread is
+ * running, safe to call concurrently with mida_free_deferred().
+ *
+ * @return Amount of blocks freed
+ */
+MIDA_API size_t mida_reclaim(void);
+
+/**
+ * @brief Starts a background thread calling mida_reclaim() periodically
+ *
+ * @param interval_ms Milliseconds between two reclaim passes
+ * @return 0 on success, -1 if already running or the thread couldn't be
+ *      created
+ */
+MIDA_API int mida_reclaimer_start(const unsigned long interval_ms);
+
+/**
+ * @brief Stops the background reclaimer thread after a last reclaim pass
+ */
+MIDA_API void mida_reclaimer_stop(void);
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+#ifndef MIDA_EPOCH_FREQ
+#define MIDA_EPOCH_FREQ 64
+#endif /* MIDA_EPOCH_FREQ */
+
+/**
+ * @brief Enters an epoch read-side critical section
+ *
+ * Blocks retired with mida_retire() are not freed while a thread that could
+ * still observe them is inside a critical section. Sections may be nested.
+ */
+MIDA_API void mida_epoch_enter(void);
+
+/**
+ * @brief Leaves an epoch read-side critical section
+ */
+MIDA_API void mida_epoch_exit(void);
+
+MIDA_API void __mida_retire(void *container);
+
+/**
+ * @def mida_retire(_container, _base)
+ * @brief Frees memory once no reader may still be accessing it
+ *
+ * The block must already be unreachable to new readers, e.g. replaced with
+ * mida_epoch_publish(). It is linked through its first bytes, so it must be
+ * at least pointer sized.
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_retire(_container, _base) __mida_retire(MIDA(_container, _base))
+
+/**
+ * @brief Frees the retired blocks of the calling thread that became safe
+ *
+ * Called automatically every MIDA_EPOCH_FREQ retires.
+ *
+ * @return Amount of blocks freed
+ */
+MIDA_API size_t mida_epoch_collect(void);
+
+/**
+ * @brief Waits for current readers and frees every block the calling thread
+ *      retired
+ *
+ * Must not be called from inside a read-side critical section.
+ *
+ * @return Amount of blocks freed
+ */
+MIDA_API size_t mida_epoch_synchronize(void);
+
+/**
+ * @def mida_epoch_load(_shared)
+ * @brief Reads a shared pointer from inside a read-side critical section
+ *
+ * @param _shared Lvalue of the shared pointer
+ */
+#define mida_epoch_load(_shared) __atomic_load_n(&(_shared), __ATOMIC_ACQUIRE)
+
+/**
+ * @def mida_epoch_publish(_shared, _base)
+ * @brief Replaces a shared pointer, readers see either the old or the new
+ *      block fully initialized
+ *
+ * @param _shared Lvalue of the shared pointer
+ * @param _base The new pointer
+ * @return The old pointer, to be passed to mida_retire()
+ */
+#define mida_epoch_publish(_shared, _base)                                    \
+    __atomic_exchange_n(&(_shared), _base, __ATOMIC_ACQ_REL)
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+#ifdef MIDA_WITH_ATOMICS
+
+/**
+ * @struct mida_seqlock
+ * @brief Sequence counter guarding a container
+ *
+ * Must be the first member of the container. Lets a single writer update
+ * the container while any amount of readers take consistent snapshots of
+ * it with mida_meta_read(), without locks or per-field atomics.
+ */
+struct mida_seqlock {
+    unsigned long seq;
+};
+
+MIDA_API void __mida_meta_write_begin(void *container);
+
+/**
+ * @def mida_meta_write_begin(_container, _base)
+ * @brief Starts updating a container guarded by a struct mida_seqlock
+ *
+ * Writers must be serialized by the caller.
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_meta_write_begin(_container, _base)                              \
+    __mida_meta_write_begin(MIDA(_container, _base))
+
+MIDA_API void __mida_meta_write_end(void *container);
+
+/**
+ * @def mida_meta_write_end(_container, _base)
+ * @brief Publishes the updates made since mida_meta_write_begin()
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_meta_write_end(_container, _base)                                \
+    __mida_meta_write_end(MIDA(_container, _base))
+
+MIDA_API void __mida_meta_read(const void *container,
+                               void *copy,
+                               const size_t container_size);
+
+/**
+ * @def mida_meta_read(_container, _base, _copy)
+ * @brief Copies a consistent snapshot of a container guarded by a
+ *      struct mida_seqlock
+ *
+ * Retries while a write is in progress or happened during the copy.
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ * @param _copy Pointer to a `_container` receiving the snapshot
+ */
+#define mida_meta_read(_container, _base, _copy)                              \
+    __mida_meta_read(MIDA(_container, _base), _copy, sizeof(_container))
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifdef MIDA_WITH_ATOMICS
+
+/**
+ * @typedef mida_handle
+ * @brief Generational reference to a MIDA object
+ *
+ * Packs the slot index in the lower 32 bits and the slot generation in the
+ * upper 32 bits, a zero handle is never valid.
+ */
+typedef uint64_t mida_handle;
+
+struct mida_handle_slot {
+    uint32_t generation;
+    uint32_t next_free;
+    void *base;
+};
+
+/**
+ * @struct mida_handles
+ * @brief Fixed-size table of MIDA objects referenced by handles
+ *
+ * Freeing an object bumps the generation of its slot, so stale handles
+ * resolve to NULL instead of dangling. The table never moves, handles may be
+ * resolved from any thread. Objects are allocated from a struct mida_pool,
+ * so that freeing one recycles its block rather than returning it to the
+ * system allocator.
+ */
+struct mida_handles {
+    struct mida_handle_slot *slots;
+    /** pool the objects are allocated from, NULL for the heap */
+    struct mida_pool *pool;
+    uint32_t capacity;
+    uint32_t free_head;
+    int lock;
+};
+
+/**
+ * @brief Initializes a handle table
+ *
+ * @param table The table to be initialized
+ * @param capacity Maximum amount of live objects
+ * @param pool Pool to allocate the objects from, which must outlive them,
+ *      or NULL to use mida_malloc()
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_handles_init(struct mida_handles *table,
+                               const uint32_t capacity,
+                               struct mida_pool *pool);
+
+/**
+ * @brief Releases the table storage (but not the live objects)
+ *
+ * @param table The table to be cleaned up
+ */
+MIDA_API void mida_handles_cleanup(struct mida_handles *table);
+
+MIDA_API mida_handle __mida_handle_malloc(struct mida_handles *table,
+                                          const size_t container_size,
+                                          const size_t element_size,
+                                          const size_t count);
+
+/**
+ * @def mida_handle_malloc(_table, _container, _element_size, _count)
+ * @brief Allocates a MIDA object referenced by a handle
+ *
+ * @param _table The handle table
+ * @param _container Type of the container structure
+ * @param _element_size Size of each element in bytes
+ * @param _count Number of elements to allocate
+ * @return The handle, or 0 if the table is full or allocation failed,
+ *      e.g. because the object is larger than the biggest class of the pool
+ */
+#define mida_handle_malloc(_table, _container, _element_size, _count)         \
+    __mida_handle_malloc(_table, sizeof(_container), _element_size, _count)
+
+/**
+ * @brief Resolves a handle without locking, with two loads and a compare
+ *
+ * @param table The handle table
+ * @param handle The handle to be resolved
+ * @return Pointer to the data (not the container), or NULL if the object was
+ *      freed
+ */
+MIDA_API void *mida_handle_get(const struct mida_handles *table,
+                               const mida_handle handle);
+
+/**
+ * @brief Invalidates a handle without freeing its object
+ *
+ * Lets the caller defer the actual free, e.g. to mida_retire() when other
+ * threads may have resolved the handle already. The object is to be
+ * returned with mida_pool_free() if the table has a pool.
+ *
+ * @param table The handle table
+ * @param handle The handle to be invalidated
+ * @return Pointer to the data (not the container), or NULL if the handle
+ *      was already stale
+ */
+MIDA_API void *mida_handle_release(struct mida_handles *table,
+                                   const mida_handle handle);
+
+/**
+ * @def mida_handle_free(_table, _container, _handle)
+ * @brief Invalidates a handle and frees its object
+ *
+ * @param _table The handle table
+ * @param _container Type of the container structure
+ * @param _handle The handle, stale handles are ignored
+ */
+#define mida_handle_free(_table, _container, _handle)                         \
+    __mida_handle_free(_table, mida_handle_release(_table, _handle),          \
+                       sizeof(_container))
+
+MIDA_API void __mida_handle_free(struct mida_handles *table,
+                                 void *base,
+                                 const size_t container_size);
+
+#endif /* MIDA_WITH_ATOMICS */
+
+/**
+ * @struct mida_soa_id
+ * @brief Container of objects whose metadata lives in a struct mida_soa
+ */
+struct mida_soa_id {
+    size_t id;
+};
+
+/**
+ * @struct mida_soa
+ * @brief Columnar side table of metadata
+ *
+ * Stores each metadata field in its own column indexed by object id, so
+ * scanning or stamping one field across many objects walks contiguous
+ * memory instead of one header per cache line. Objects only carry their id
+ * in a struct mida_soa_id container.
+ */
+struct mida_soa {
+    /** column storage, `columns[c]` holds `capacity` cells */
+    void **columns;
+    /** size of a cell of each column */
+    size_t *sizes;
+    /** number of columns */
+    size_t ncolumns;
+    /** one past the highest id ever assigned */
+    size_t length;
+    /** number of cells allocated per column */
+    size_t capacity;
+    /** stack of ids released by mida_soa_free(), to be reused */
+    size_t *free_ids;
+    /** number of ids in `free_ids` */
+    size_t nfree;
+};
+
+/**
+ * @def MIDA_SOA_FIELD(_container, _field)
+ * @brief Size of a container field, for declaring a matching column
+ */
+#define MIDA_SOA_FIELD(_container, _field) sizeof(((_container *)0)->_field)
+
+/**
+ * @brief Initializes a columnar side table
+ *
+ * @param soa The table to be initialized
+ * @param sizes Cell size of each column, e.g. from MIDA_SOA_FIELD()
+ * @param ncolumns Number of columns
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_soa_init(struct mida_soa *soa,
+                           const size_t sizes[],
+                           const size_t ncolumns);
+
+/**
+ * @brief Releases the table storage (but not the objects)
+ *
+ * @param soa The table to be cleaned up
+ */
+MIDA_API void mida_soa_cleanup(struct mida_soa *soa);
+
+/**
+ * @brief Allocates an array whose metadata lives in the table
+ *
+ * The object gets its id in a struct mida_soa_id container and its cells
+ * are zeroed.
+ *
+ * @param soa The table
+ * @param element_size Size of each element in bytes
+ * @param count Number of elements to allocate
+ * @return Pointer to the allocated array (not the container)
+ */
+MIDA_API void *mida_soa_malloc(struct mida_soa *soa,
+                               const size_t element_size,
+                               const size_t count);
+
+/**
+ * @brief Frees an array allocated with mida_soa_malloc() and recycles its id
+ *
+ * @param soa The table
+ * @param base Pointer to the data (not the container)
+ */
+MIDA_API void mida_soa_free(struct mida_soa *soa, void *base);
+
+/**
+ * @def mida_soa_column(_soa, _type, _column)
+ * @brief Gets a column as a contiguous array of `_soa->length` cells
+ *
+ * Cells of freed ids are kept until the id is reused. Column pointers are
+ * invalidated when the table grows.
+ */
+#define mida_soa_column(_soa, _type, _column)                                 \
+    ((_type *)(_soa)->columns[_column])
+
+/**
+ * @def MIDA_SOA(_soa, _type, _column, _base)
+ * @brief Gets the metadata cell of an object, like MIDA() does for the
+ *      inline container
+ *
+ * @param _soa The table
+ * @param _type Type of the cell
+ * @param _column Index of the column
+ * @param _base Pointer to the data (not the container)
+ * @return Lvalue of the cell
+ */
+#define MIDA_SOA(_soa, _type, _column, _base)                                 \
+    (mida_soa_column(_soa, _type, _column)                                    \
+         [MIDA(struct mida_soa_id, _base)->id])
+
+#ifdef MIDA_WITH_ATOMICS
+
+#ifndef MIDA_SIDETABLE_CAPACITY
+#define MIDA_SIDETABLE_CAPACITY 4096
+#endif /* MIDA_SIDETABLE_CAPACITY */
+
+struct mida_sidetable_entry {
+    void *base;
+    void *container;
+};
+
+/**
+ * @struct mida_sidetable
+ * @brief Lock-free hash table mapping foreign buffers to their container
+ *
+ * For buffers that have no room for a container right before the data (mmap
+ * regions, buffers owned by other libraries, device memory). Detaching
+ * leaves a tombstone that later attaches reuse, so the table must be sized
+ * for the amount of buffers attached at the same time. A buffer must not be
+ * attached or detached by two threads at once.
+ */
+struct mida_sidetable {
+    struct mida_sidetable_entry *entries;
+    size_t mask;
+};
+
+/**
+ * @brief Initializes a side table
+ *
+ * @param table The table to be initialized
+ * @param capacity Maximum amount of buffers, rounded up to a power of two
+ * @return 0 on success, -1 on allocation failure
+ */
+MIDA_API int mida_sidetable_init(struct mida_sidetable *table,
+                                 const size_t capacity);
+
+/**
+ * @brief Releases the table storage (but not the containers)
+ *
+ * @param table The table to be cleaned up
+ */
+MIDA_API void mida_sidetable_cleanup(struct mida_sidetable *table);
+
+/**
+ * @brief Attaches a container to a buffer, safe to call from any thread
+ *
+ * @param table The table
+ * @param base Pointer to the buffer
+ * @param container Pointer to the container, owned by the caller
+ * @return 0 on success, -1 if the table is full
+ */
+MIDA_API int mida_sidetable_attach(struct mida_sidetable *table,
+                                   const void *base,
+                                   void *container);
+
+/**
+ * @brief Gets the container attached to a buffer, safe to call from any
+ *      thread
+ *
+ * @param table The table
+ * @param base Pointer to the buffer
+ * @return The container, or NULL if none is attached
+ */
+MIDA_API void *mida_sidetable_lookup(const struct mida_sidetable *table,
+                                     const void *base);
+
+/**
+ * @brief Detaches the container of a buffer, safe to call from any thread
+ *
+ * @param table The table
+ * @param base Pointer to the buffer
+ * @return The detached container, or NULL if none was attached
+ */
+MIDA_API void *mida_sidetable_detach(struct mida_sidetable *table,
+                                     const void *base);
+
+/**
+ * @brief Attaches a container to a buffer in the global side table
+ *
+ * The global table holds MIDA_SIDETABLE_CAPACITY buffers (must be a power of
+ * two).
+ *
+ * @param base Pointer to the buffer
+ * @param container Pointer to the container, owned by the caller
+ * @return 0 on success, -1 if the table is full
+ */
+MIDA_API int mida_attach(const void *base, void *container);
+
+/**
+ * @brief Gets the container attached to a buffer in the global side table
+ *
+ * @param base Pointer to the buffer
+ * @return The container, or NULL if none is attached
+ */
+MIDA_API void *mida_lookup(const void *base);
+
+/**
+ * @brief Detaches the container of a buffer in the global side table
+ *
+ * @param base Pointer to the buffer
+ * @return The detached container, or NULL if none was attached
+ */
+MIDA_API void *mida_detach(const void *base);
+
+/**
+ * @def MIDA_LOOKUP(_container, _base)
+ * @brief Gets the container of a foreign buffer, like MIDA() does for
+ *      buffers carrying their container
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the buffer
+ * @return Pointer to the container, or NULL if none is attached
+ */
+#define MIDA_LOOKUP(_container, _base) ((_container *)mida_lookup(_base))
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifndef MIDA_LAYER_MAX
+#define MIDA_LAYER_MAX 8
+#endif /* MIDA_LAYER_MAX */
+
+/**
+ * @struct mida_layers
+ * @brief Container of a buffer whose metadata is stacked in layers
+ *
+ * Each subsystem pushes its own container into headroom reserved before
+ * this struct, so adding a layer never moves or copies the data.
+ */
+struct mida_layers {
+    /** amount of bytes reserved for layers */
+    size_t reserve;
+    /** amount of reserved bytes claimed by layers */
+    size_t used;
+    /** number of layers pushed */
+    size_t count;
+    /** distance from this struct back to each layer */
+    size_t offsets[MIDA_LAYER_MAX];
+};
+
+/**
+ * @brief Allocates memory with room for stacking metadata layers
+ *
+ * @param reserve Amount of bytes reserved for layers
+ * @param element_size Size of each element in bytes
+ * @param count Number of elements to allocate
+ * @return Pointer to the allocated array (not the container)
+ */
+MIDA_API void *mida_layered_malloc(const size_t reserve,
+                                   const size_t element_size,
+                                   const size_t count);
+
+/**
+ * @brief Frees memory allocated with mida_layered_malloc()
+ *
+ * @param base Pointer to the data (not the container)
+ */
+MIDA_API void mida_layered_free(void *base);
+
+MIDA_API int __mida_layer_push(void *base, const size_t container_size);
+
+/**
+ * @def mida_layer_push(_base, _container)
+ * @brief Claims reserved headroom for a zeroed metadata layer
+ *
+ * @param _base Pointer to the data (not the container)
+ * @param _container Type of the layer's container structure
+ * @return Id of the layer, or -1 if there's not enough headroom left or
+ *      MIDA_LAYER_MAX layers were already pushed
+ */
+#define mida_layer_push(_base, _container)                                    \
+    __mida_layer_push(_base, sizeof(_container))
+
+/**
+ * @brief Releases the most recently pushed layer
+ *
+ * @param base Pointer to the data (not the container)
+ */
+MIDA_API void mida_layer_pop(void *base);
+
+/**
+ * @def MIDA_LAYER(_container, _base, _id)
+ * @brief Gets a metadata layer in O(1)
+ *
+ * @param _container Type of the layer's container structure
+ * @param _base Pointer to the data (not the container)
+ * @param _id Id returned by mida_layer_push()
+ * @return Pointer to the layer's container
+ */
+#define MIDA_LAYER(_container, _base, _id)                                    \
+    ((_container *)((mida_byte *)MIDA(struct mida_layers, _base)              \
+                    - MIDA(struct mida_layers, _base)->offsets[_id]))
+
+struct mida_type;
+
+/**
+ * @struct mida_field
+ * @brief Describes a member of an element pointing to another MIDA object
+ */
+struct mida_field {
+    /** offset of the pointer within an element */
+    size_t offset;
+    /** type of the pointed MIDA object */
+    const struct mida_type *type;
+};
+
+/**
+ * @def MIDA_FIELD(_element, _member, _type)
+ * @brief Initializer of a struct mida_field
+ *
+ * @param _element Type of the elements holding the pointer
+ * @param _member Name of the pointer member
+ * @param _type Pointer to the struct mida_type of the pointed object
+ */
+#define MIDA_FIELD(_element, _member, _type)                                  \
+    {                                                                         \
+        offsetof(_element, _member), _type                                    \
+    }
+
+/**
+ * @struct mida_type
+ * @brief Type descriptor of a MIDA object
+ *
+ * Descriptors reference each other through their fields, forming the
+ * registry walked by mida_clone_deep() and mida_free_deep().
+ */
+struct mida_type {
+    /** size of the container structure */
+    size_t container_size;
+    /** size of each element */
+    size_t element_size;
+    /** gets the number of elements of an object, NULL if always one */
+    size_t (*count)(const void *base);
+    /** members of each element pointing to other MIDA objects */
+    const struct mida_field *fields;
+    /** number of fields */
+    size_t nfields;
+};
+
+/**
+ * @brief Copies a tree of MIDA objects into a single contiguous allocation
+ *
+ * Objects are laid out in depth-first order with the root first, so the
+ * whole clone is released with a plain mida_free() of the root. Objects
+ * reachable through more than one pointer are duplicated, cycles are not
+ * supported.
+ *
+ * @param type Type descriptor of the root
+ * @param base Pointer to the data of the root (not the container)
+ * @return Pointer to the data of the cloned root, or NULL on allocation
+ *      failure
+ */
+MIDA_API void *mida_clone_deep(const struct mida_type *type, const void *base);
+
+/**
+ * @brief Frees a tree of individually allocated MIDA objects
+ *
+ * The tree is walked with a heap allocated stack; should growing it fail,
+ * the remaining subtrees are freed recursively instead of being leaked.
+ *
+ * @param type Type descriptor of the root
+ * @param base Pointer to the data of the root (not the container)
+ */
+MIDA_API void mida_free_deep(const struct mida_type *type, void *base);
+
+#ifndef MIDA_NEAR_CHUNK
+#define MIDA_NEAR_CHUNK 4096
+#endif /* MIDA_NEAR_CHUNK */
+
+MIDA_API void *__mida_malloc_near(void *parent_container,
+                                  const size_t container_size,
+                                  const size_t element_size,
+                                  const size_t count);
+
+/**
+ * @def mida_malloc_near(_parent_container, _parent, _container,
+ *      _element_size, _count)
+ * @brief Allocates memory with extended metadata next to a parent object
+ *
+ * Objects are carved out of chunks of MIDA_NEAR_CHUNK bytes shared by the
+ * parent's group, so a parent and its children end up within a few cache
+ * lines of each other. A NULL parent starts a new group. Memory of a group
+ * is only released once every object of the group was freed with
+ * mida_free_near().
+ *
+ * @param _parent_container Type of the parent's container structure
+ * @param _parent Pointer to the parent's data, allocated with
+ *      mida_malloc_near(), or NULL
+ * @param _container Type of the container structure
+ * @param _element_size Size of each element in bytes
+ * @param _count Number of elements to allocate
+ * @return Pointer to the allocated array (not the container)
+ */
+#define mida_malloc_near(_parent_container, _parent, _container,              \
+                         _element_size, _count)                               \
+    __mida_malloc_near(                                                       \
+        (_parent) ? (void *)MIDA(_parent_container, _parent) : NULL,          \
+        sizeof(_container), _element_size, _count)
+
+MIDA_API void __mida_free_near(void *container);
+
+/**
+ * @def mida_free_near(_container, _base)
+ * @brief Frees memory allocated with mida_malloc_near()
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_free_near(_container, _base)                                     \
+    __mida_free_near((_base) ? (void *)MIDA(_container, _base) : NULL)
+
+#ifndef MIDA_PREFETCH_DATA
+#define MIDA_PREFETCH_DATA MIDA_CACHELINE
+#endif /* MIDA_PREFETCH_DATA */
+
+#ifndef MIDA_WALK_MAX
+#define MIDA_WALK_MAX 16
+#endif /* MIDA_WALK_MAX */
+
+#ifdef MIDA_WITH_ATOMICS
+#define __mida_prefetch_line(_addr) __builtin_prefetch((_addr), 0, 3)
+#else
+#define __mida_prefetch_line(_addr) ((void)(_addr))
+#endif /* MIDA_WITH_ATOMICS */
+
+/**
+ * @def mida_prefetch_range(_addr, _size)
+ * @brief Prefetches every cache line of a memory range for reading
+ *
+ * A no-op on compilers without a prefetch builtin.
+ *
+ * @param _addr Start of the range
+ * @param _size Size of the range in bytes
+ */
+#define mida_prefetch_range(_addr, _size)                                     \
+    do {                                                                      \
+        const mida_byte *__p = (const mida_byte *)(_addr),                    \
+                        *__end = __p + (_size);                               \
+        for (; __p < __end; __p += MIDA_CACHELINE)                            \
+            __mida_prefetch_line(__p);                                        \
+        __mida_prefetch_line(__end - 1);                                      \
+    } while (0)
+
+/**
+ * @def mida_prefetch(_container, _base)
+ * @brief Prefetches the container and the first MIDA_PREFETCH_DATA bytes of
+ *      data of an object
+ *
+ * @param _container Type of the container structure
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_prefetch(_container, _base)                                      \
+    mida_prefetch_range(MIDA(_container, _base),                              \
+                        sizeof(_container) + MIDA_PREFETCH_DATA)
+
+/**
+ * @struct mida_walk
+ * @brief Iterator over a linked chain of MIDA objects that prefetches the
+ *      upcoming nodes
+ *
+ * Keeps a window of up to MIDA_WALK_MAX nodes ahead of the current one,
+ * whose containers and data are prefetched as soon as they are discovered.
+ */
+struct mida_walk {
+    /** ring of the nodes ahead */
+    void *window[MIDA_WALK_MAX];
+    /** index of the next node to be returned */
+    size_t head;
+    /** nodes in the window */
+    size_t count;
+    /** target number of nodes in the window */
+    size_t depth;
+    /** offset of the link to the next node, within the data */
+    size_t offset;
+    /** size of the container structure */
+    size_t container_size;
+};
+
+MIDA_API void __mida_walk_init(struct mida_walk *walk,
+                               void *first,
+                               const size_t container_size,
+                               const size_t offset,
+                               const size_t depth);
+
+/**
+ * @def mida_walk_init(_walk, _container, _first, _type, _field, _depth)
+ * @brief Starts walking a chain of MIDA objects
+ *
+ * @param _walk Pointer to the iterator
+ * @param _container Type of the container structure of the nodes
+ * @param _first Pointer to the data of the first node, or NULL
+ * @param _type Type of the nodes' data
+ * @param _field Member of `_type` pointing to the next node's data
+ * @param _depth How many nodes to prefetch ahead, up to MIDA_WALK_MAX
+ */
+#define mida_walk_init(_walk, _container, _first, _type, _field, _depth)      \
+    __mida_walk_init(_walk, _first, sizeof(_container),                       \
+                     offsetof(_type, _field), _depth)
+
+/**
+ * @brief Gets the next node of a walk
+ *
+ * @param walk Pointer to the iterator
+ * @return Pointer to the data of the node, or NULL once the chain ends
+ */
+MIDA_API void *mida_walk_next(struct mida_walk *walk);
+
+#define MIDA_COMPACT_FLAG_BITS 2
+
+/**
+ * @brief Allocates memory with a compact variable-length header
+ *
+ * The header is a varint holding the length and MIDA_COMPACT_FLAG_BITS bits
+ * of user flags, stored backwards in the bytes right before the data so
+ * that it is decoded from the data pointer in a bounded number of steps.
+ * It takes one byte for lengths below 32, two below 4096. The data has no
+ * alignment guarantee, which suits strings and byte buffers.
+ *
+ * @param length Size of the data in bytes
+ * @param flags User flags, below (1 << MIDA_COMPACT_FLAG_BITS)
+ * @return Pointer to the data, or NULL on failure
+ */
+MIDA_API void *mida_compact_malloc(const size_t length, const unsigned flags);
+
+/**
+ * @brief Copies a string into memory with a compact header
+ *
+ * @param string The string to copy, need not be NUL-terminated
+ * @param length Length of the string, excluding the NUL-terminator
+ * @return Pointer to the NUL-terminated copy, or NULL on failure
+ */
+MIDA_API char *mida_compact_string(const char *string, const size_t length);
+
+/**
+ * @brief Gets the length stored in a compact header
+ *
+ * @param base Pointer to the data
+ * @return The length, excluding the NUL-terminator for strings
+ */
+MIDA_API size_t mida_compact_length(const void *base);
+
+/**
+ * @brief Gets the user flags stored in a compact header
+ *
+ * @param base Pointer to the data
+ * @return The flags
+ */
+MIDA_API unsigned mida_compact_flags(const void *base);
+
+/**
+ * @brief Replaces the user flags stored in a compact header, in place
+ *
+ * @param base Pointer to the data
+ * @param flags User flags, below (1 << MIDA_COMPACT_FLAG_BITS)
+ */
+MIDA_API void mida_compact_set_flags(void *base, const unsigned flags);
+
+/**
+ * @brief Frees memory allocated with a compact header
+ *
+ * @param base Pointer to the data, or NULL
+ */
+MIDA_API void mida_compact_free(void *base);
+
+/**
+ * @struct mida_str
+ * @brief Container of a growable NUL-terminated string
+ */
+struct mida_str {
+    /** length of the string, excluding the NUL-terminator */
+    size_t length;
+    /** characters the buffer can hold, excluding the NUL-terminator */
+    size_t capacity;
+};
+
+/**
+ * @brief Creates a growable string
+ *
+ * @param string Initial contents, or NULL for an empty string
+ * @return Pointer to the NUL-terminated string, or NULL on failure
+ */
+MIDA_API char *mida_str_new(const char *string);
+
+/**
+ * @brief Ensures a growable string can take extra characters without
+ *      reallocating
+ *
+ * The capacity grows geometrically, so that a sequence of appends runs in
+ * amortized constant time per character.
+ *
+ * @param p_string Pointer to the string, which may be moved; a NULL string
+ *      is created
+ * @param extra Number of characters to make room for
+ * @return 0 on success, -1 on failure (the string is left untouched)
+ */
+MIDA_API int mida_str_reserve(char **p_string, const size_t extra);
+
+/**
+ * @brief Appends characters to a growable string
+ *
+ * @param p_string Pointer to the string, which may be moved; a NULL string
+ *      is created
+ * @param src Characters to append, need not be NUL-terminated; may point
+ *      into the string itself
+ * @param n Number of characters to append
+ * @return 0 on success, -1 on failure (the string is left untouched)
+ */
+MIDA_API int mida_str_appendn(char **p_string, const char *src, size_t n);
+
+/**
+ * @brief Appends a NUL-terminated string to a growable string
+ *
+ * @param p_string Pointer to the string, which may be moved; a NULL string
+ *      is created
+ * @param src The NUL-terminated string to append, which may be the string
+ *      itself
+ * @return 0 on success, -1 on failure (the string is left untouched)
+ */
+MIDA_API int mida_str_append(char **p_string, const char *src);
+
+#ifdef MIDA_WITH_C99
+
+/**
+ * @brief Appends formatted output to a growable string
+ *
+ * @param p_string Pointer to the string, which may be moved; a NULL string
+ *      is created
+ * @param format printf() format string, whose arguments may point into the
+ *      string itself
+ * @return 0 on success, -1 on failure (the string is left untouched)
+ */
+MIDA_API int mida_str_appendf(char **p_string, const char *format, ...);
+
+#endif /* MIDA_WITH_C99 */
+
+/**
+ * @brief Empties a growable string, keeping its capacity
+ *
+ * @param string The string
+ */
+MIDA_API void mida_str_clear(char *string);
+
+/**
+ * @brief Frees a growable string
+ *
+ * @param string The string, or NULL
+ */
+MIDA_API void mida_str_free(char *string);
+
+/**
+ * @struct mida_hstr
+ * @brief Container of a string that caches its hash
+ */
+struct mida_hstr {
+    /** mida_hash() of the string, computed once at creation */
+    uint64_t hash;
+    /** length of the string, excluding the NUL-terminator */
+    size_t length;
+};
+
+/**
+ * @brief Hashes a memory range
+ *
+ * 64-bit hash of the xxHash family (XXH64 with a zero seed), fast on both
+ * short keys and long buffers.
+ *
+ * @param data The memory range
+ * @param length Size of the range in bytes
+ * @return The hash
+ */
+MIDA_API uint64_t mida_hash(const void *data, const size_t length);
+
+/**
+ * @brief Copies a string and caches its hash in the container
+ *
+ * @param string The string to copy, need not be NUL-terminated
+ * @param length Length of the string, excluding the NUL-terminator
+ * @return Pointer to the NUL-terminated copy, or NULL on failure
+ */
+MIDA_API char *mida_hstr_new(const char *string, const size_t length);
+
+/**
+ * @brief Compares two strings with cached hashes
+ *
+ * Strings with different hashes or lengths are told apart without reading
+ * their contents.
+ *
+ * @param a String created with mida_hstr_new() or mida_intern()
+ * @param b String created with mida_hstr_new() or mida_intern()
+ * @return Non-zero if the strings are equal
+ */
+MIDA_API int mida_hstr_equals(const char *a, const char *b);
+
+/**
+ * @brief Frees a string created with mida_hstr_new()
+ *
+ * @param string The string, or NULL
+ */
+MIDA_API void mida_hstr_free(char *string);
+
+#ifdef MIDA_WITH_ATOMICS
+
+#ifndef MIDA_INTERN_SHARDS
+#define MIDA_INTERN_SHARDS 16
+#endif /* MIDA_INTERN_SHARDS */
+
+/**
+ * @struct mida_intern_shard
+ * @brief Open-addressing table of interned strings, under its own lock
+ */
+struct mida_intern_shard {
+    int lock;
+    /** interned strings, NULL for empty slots */
+    char **slots;
+    /** number of slots, a power of two */
+    size_t capacity;
+    /** number of interned strings */
+    size_t count;
+};
+
+/**
+ * @struct mida_interns
+ * @brief Pool of deduplicated strings
+ *
+ * Strings are spread among MIDA_INTERN_SHARDS independently locked shards by
+ * hash, so that threads interning different strings rarely contend. Safe to
+ * use from multiple threads.
+ */
+struct mida_interns {
+    struct mida_intern_shard shards[MIDA_INTERN_SHARDS];
+};
+
+/**
+ * @brief Initializes a pool of interned strings
+ *
+ * @param pool The pool to be initialized
+ */
+MIDA_API void mida_interns_init(struct mida_interns *pool);
+
+/**
+ * @brief Frees a pool and every string interned in it
+ *
+ * @param pool The pool to be cleaned up
+ */
+MIDA_API void mida_interns_cleanup(struct mida_interns *pool);
+
+/**
+ * @brief Gets the unique copy of a string in a pool, adding it if needed
+ *
+ * Interning equal strings gives the same pointer, so they can be compared
+ * with `==`. The copy is a mida_hstr, which lives until the pool is cleaned
+ * up and must not be modified.
+ *
+ * @param pool The pool
+ * @param string The string, need not be NUL-terminated
+ * @param length Length of the string, excluding the NUL-terminator
+ * @return Pointer to the interned string, or NULL on failure
+ */
+MIDA_API const char *mida_intern(struct mida_interns *pool,
+                                 const char *string,
+                                 const size_t length);
+
+#endif /* MIDA_WITH_ATOMICS */
+
+/**
+ * @struct mida_slice
+ * @brief A view on part of a string, not NUL-terminated
+ */
+struct mida_slice {
+    const char *data;
+    size_t length;
+};
+
+/**
+ * @brief Tells whether two growable strings are equal
+ *
+ * Like the rest of the mida_str_* operations below, it relies on the
+ * lengths stored in the containers instead of scanning for NUL-terminators,
+ * and runs SSE2 or AVX2 kernels picked at runtime where available.
+ *
+ * @param a String created with mida_str_new()
+ * @param b String created with mida_str_new()
+ * @return Non-zero if the strings are equal
+ */
+MIDA_API int mida_str_equals(const char *a, const char *b);
+
+/**
+ * @brief Compares two growable strings, byte-wise
+ *
+ * @param a String created with mida_str_new()
+ * @param b String created with mida_str_new()
+ * @return Negative, zero or positive, as with strcmp()
+ */
+MIDA_API int mida_str_compare(const char *a, const char *b);
+
+/**
+ * @brief Finds the first occurrence of a substring in a growable string
+ *
+ * @param string String created with mida_str_new()
+ * @param needle Substring to look for, need not be NUL-terminated
+ * @param length Length of the substring
+ * @return Pointer to the occurrence within `string`, or NULL if not found
+ */
+MIDA_API char *mida_str_find(const char *string,
+                             const char *needle,
+                             const size_t length);
+
+/**
+ * @brief Finds the first character of a growable string that belongs to a
+ *      set, as strpbrk()
+ *
+ * @param string String created with mida_str_new()
+ * @param set NUL-terminated set of characters
+ * @return Pointer to the character within `string`, or NULL if not found
+ */
+MIDA_API char *mida_str_find_any(const char *string, const char *set);
+
+/**
+ * @brief Converts the ASCII letters of a growable string to lowercase, in
+ *      place
+ *
+ * @param string String created with mida_str_new()
+ */
+MIDA_API void mida_str_to_lower(char *string);
+
+/**
+ * @brief Splits a growable string around a separator
+ *
+ * The slices point into `string`, which must outlive them. Their count is
+ * kept as the `length` of the array's `struct mida_str` container.
+ *
+ * @param string String created with mida_str_new()
+ * @param separator Character to split around
+ * @return Array of slices, to be released with
+ *      `mida_free(struct mida_str, slices)`, or NULL on failure
+ */
+MIDA_API struct mida_slice *mida_str_split(const char *string,
+                                           const char separator);
+
+/**
+ * @struct mida_hnode
+ * @brief Hash map link, to be embedded in a container structure
+ */
+struct mida_hnode {
+    struct mida_hnode *next;
+    /** hash of the object's key, cached when inserted */
+    uint64_t hash;
+};
+
+/**
+ * @struct mida_map
+ * @brief Intrusive chained hash map of MIDA objects
+ *
+ * The links and cached hashes live in the objects' containers, so
+ * inserting an object allocates nothing besides the occasional growth of
+ * the bucket array, and a lookup lands on the objects directly. Growing
+ * reuses the cached hashes instead of rehashing keys. Not thread-safe.
+ */
+struct mida_map {
+    struct mida_hnode **buckets;
+    /** number of buckets minus one, buckets are a power of two */
+    size_t mask;
+    /** number of objects in the map */
+    size_t count;
+    /** distance in bytes from an object's mida_hnode to its data */
+    size_t distance;
+    /** tells whether an object matches a key, NULL to match by hash only */
+    int (*eq)(const void *base, const void *key);
+};
+
+MIDA_API void __mida_map_init(struct mida_map *map,
+                              const size_t distance,
+                              int (*eq)(const void *base, const void *key));
+
+/**
+ * @def mida_map_init(_map, _container, _field, _eq)
+ * @brief Initializes an intrusive hash map
+ *
+ * @param _map Pointer to the map
+ * @param _container Type of the container structure of the objects
+ * @param _field Member of `_container` of type `struct mida_hnode`
+ * @param _eq Function comparing an object's data with a key, or NULL when
+ *      the hash itself is the key
+ */
+#define mida_map_init(_map, _container, _field, _eq)                          \
+    __mida_map_init(_map, sizeof(_container) - offsetof(_container, _field),  \
+                    _eq)
+
+/**
+ * @brief Releases the buckets of a map, leaving the objects untouched
+ *
+ * @param map The map to be cleaned up
+ */
+MIDA_API void mida_map_cleanup(struct mida_map *map);
+
+/**
+ * @brief Inserts an object into a map
+ *
+ * Does not check for an object with the same key already in the map.
+ *
+ * @param map The map
+ * @param base Pointer to the object's data (not the container)
+ * @param hash Hash of the object's key
+ * @return 0 on success, -1 on failure
+ */
+MIDA_API int mida_map_insert(struct mida_map *map,
+                             void *base,
+                             const uint64_t hash);
+
+/**
+ * @brief Finds an object in a map
+ *
+ * @param map The map
+ * @param hash Hash of the key
+ * @param key The key, passed to the map's `eq` function
+ * @return Pointer to the object's data, or NULL if not found
+ */
+MIDA_API void *mida_map_find(const struct mida_map *map,
+                             const uint64_t hash,
+                             const void *key);
+
+/**
+ * @brief Finds an object in a map and removes it
+ *
+ * @param map The map
+ * @param hash Hash of the key
+ * @param key The key, passed to the map's `eq` function
+ * @return Pointer to the removed object's data, or NULL if not found
+ */
+MIDA_API void *mida_map_remove(struct mida_map *map,
+                               const uint64_t hash,
+                               const void *key);
+
+/**
+ * @brief Removes a given object from a map
+ *
+ * @param map The map
+ * @param base Pointer to the data of an object in the map
+ */
+MIDA_API void mida_map_unlink(struct mida_map *map, void *base);
+
+/**
+ * @brief Iterates over the objects of a map, in no particular order
+ *
+ * The current object may be unlinked before getting the next one only if
+ * its data is still readable.
+ *
+ * @param map The map
+ * @param base Pointer to the current object's data, NULL to get the first
+ * @return Pointer to the next object's data, or NULL once done
+ */
+MIDA_API void *mida_map_next(const struct mida_map *map, const void *base);
+
+#ifdef MIDA_WITH_ATOMICS
+
+#ifndef MIDA_LRU_SHARDS
+#define MIDA_LRU_SHARDS 16
+#endif /* MIDA_LRU_SHARDS */
+
+/**
+ * @struct mida_lru_node
+ * @brief Cache bookkeeping, to be embedded in a container structure
+ *
+ * Zero-initialize it, e.g. with mida_calloc(), before the object is first
+ * put in a cache.
+ */
+struct mida_lru_node {
+    struct mida_hnode hnode;
+    /** neighbours in the recency list, most recently used first */
+    struct mida_lru_node *prev, *next;
+    /** bytes the object accounts for in the budget */
+    size_t bytes;
+    /** references taken with mida_lru_get() and not released yet */
+    size_t refs;
+    /** 0 when not cached, 1 when cached, 2 once evicted while references
+     * are still held */
+    int state;
+};
+
+/**
+ * @struct mida_lru_shard
+ * @brief Independently locked part of a mida_lru
+ */
+struct mida_lru_shard {
+    int lock;
+    struct mida_map map;
+    /** sentinel of the recency list */
+    struct mida_lru_node list;
+    /** bytes of the cached objects */
+    size_t bytes;
+    /** maximum bytes of cached objects */
+    size_t budget;
+    size_t hits;
+    size_t misses;
+};
+
+/**
+ * @struct mida_lru
+ * @brief Size-bounded least recently used cache of MIDA objects
+ *
+ * Objects are spread among MIDA_LRU_SHARDS shards by hash, each with its own
+ * lock, hash map, recency list and share of the byte budget. The links and
+ * byte counts live in the objects' containers, so caching an object
+ * allocates nothing. Safe to use from multiple threads.
+ */
+struct mida_lru {
+    struct mida_lru_shard shards[MIDA_LRU_SHARDS];
+    /** distance in bytes from an object's mida_lru_node to its data */
+    size_t distance;
+    /** releases an evicted object, called outside of the shard's lock */
+    void (*evict)(void *base, void *context);
+    void *context;
+};
+
+MIDA_API void __mida_lru_init(struct mida_lru *lru,
+                              const size_t distance,
+                              const size_t budget,
+                              int (*eq)(const void *base, const void *key),
+                              void (*evict)(void *base, void *context),
+                              void *context);
+
+/**
+ * @def mida_lru_init(_lru, _container, _field, _budget, _eq, _evict,
+ *      _context)
+ * @brief Initializes a size-bounded cache
+ *
+ * @param _lru Pointer to the cache
+ * @param _container Type of the container structure of the objects
+ * @param _field Member of `_container` of type `struct mida_lru_node`
+ * @param _budget Maximum bytes of cached objects, split evenly among shards
+ * @param _eq Function comparing an object's data with a key, or NULL when
+ *      the hash itself is the key
+ * @param _evict Function releasing an evicted object, typically calling
+ *      mida_free()
+ * @param _context Passed to `_evict`
+ */
+#define mida_lru_init(_lru, _container, _field, _budget, _eq, _evict,         \
+                      _context)                                               \
+    __mida_lru_init(_lru, sizeof(_container) - offsetof(_container, _field),  \
+                    _budget, _eq, _evict, _context)
+
+/**
+ * @brief Evicts every object of a cache and releases it
+ *
+ * @param lru The cache to be cleaned up
+ */
+MIDA_API void mida_lru_cleanup(struct mida_lru *lru);
+
+/**
+ * @brief Hands an object over to a cache
+ *
+ * An object already cached under the same key is evicted, then the least
+ * recently used objects are evicted until the shard fits its budget.
+ * Putting an object that is already cached only updates its bytes and marks
+ * it as the most recently used. An object evicted while referenced can be
+ * put again under a key of the same shard, keeping its references.
+ *
+ * @param lru The cache
+ * @param base Pointer to the object's data (not the container)
+ * @param hash Hash of the object's key
+ * @param key The object's key, passed to the cache's `eq` function
+ * @param bytes Bytes the object accounts for, e.g. its data size
+ * @return 0 on success, -1 on failure or if the object is cached under
+ *      another key, or still referenced from another shard (the object is
+ *      not cached)
+ */
+MIDA_API int mida_lru_put(struct mida_lru *lru,
+                          void *base,
+                          const uint64_t hash,
+                          const void *key,
+                          const size_t bytes);
+
+/**
+ * @brief Gets a cached object and marks it as the most recently used
+ *
+ * The object is referenced, so it is not released before the matching
+ * mida_lru_release(), even if evicted meanwhile.
+ *
+ * @param lru The cache
+ * @param hash Hash of the key
+ * @param key The key, passed to the cache's `eq` function
+ * @return Pointer to the object's data, or NULL on a miss
+ */
+MIDA_API void *mida_lru_get(struct mida_lru *lru,
+                            const uint64_t hash,
+                            const void *key);
+
+/**
+ * @brief Drops a reference taken with mida_lru_get()
+ *
+ * @param lru The cache
+ * @param base Pointer to the object's data
+ */
+MIDA_API void mida_lru_release(struct mida_lru *lru, void *base);
+
+/**
+ * @brief Gets the statistics of a cache
+ *
+ * @param lru The cache
+ * @param hits Receives the number of hits, if not NULL
+ * @param misses Receives the number of misses, if not NULL
+ * @param bytes Receives the bytes currently cached, if not NULL
+ */
+MIDA_API void mida_lru_stats(struct mida_lru *lru,
+                             size_t *hits,
+                             size_t *misses,
+                             size_t *bytes);
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifdef MIDA_WITH_C99
+#define MIDA_INLINE static inline
+#elif defined(__GNUC__) || defined(__clang__)
+#define MIDA_INLINE static __inline__
+#else
+#define MIDA_INLINE static
+#endif /* MIDA_WITH_C99 */
+
+/**
+ * @def MIDA_DEFINE_VEC(_name, _container, _type)
+ * @brief Generates a growable array API specialized for an element type
+ *
+ * Unlike mida_malloc() and mida_realloc(), which take the element size at
+ * runtime, the generated inline functions know `sizeof(_type)` at compile
+ * time, so callers get the same code as with hand-written typed arrays:
+ *
+ * - `_type *name_new(size_t capacity)`
+ * - `size_t name_length(const _type *vec)`
+ * - `int name_reserve(_type **p_vec, size_t capacity)`
+ * - `int name_push(_type **p_vec, _type value)`
+ * - `_type name_get(const _type *vec, size_t index)`
+ * - `int name_resize(_type **p_vec, size_t length)`, zeroing new elements
+ * - `void name_sort(_type *vec, int (*cmp)(const _type *, const _type *))`
+ * - `_type *name_find(_type *vec, const _type *value, cmp)`, comparing
+ *      bytes if `cmp` is NULL
+ * - `void name_free(_type *vec)`
+ *
+ * Functions taking `p_vec` may move the array, and create it if NULL; the
+ * ones returning int give 0 on success and -1 on failure. See `mida_vec`
+ * for the C++ counterpart.
+ *
+ * @param _name Prefix of the generated functions
+ * @param _container Type of the container structure, with `size_t length`
+ *      and `size_t capacity` members
+ * @param _type Type of the elements
+ */
+#define MIDA_DEFINE_VEC(_name, _container, _type)                             \
+    MIDA_INLINE _type *_name##_new(const size_t capacity)                     \
+    {                                                                         \
+        _type *vec =                                                          \
+            (_type *)mida_malloc(_container, sizeof(_type), capacity);        \
+        if (vec) {                                                            \
+            MIDA(_container, vec)->length = 0;                                \
+            MIDA(_container, vec)->capacity = capacity;                       \
+        }                                                                     \
+        return vec;                                                           \
+    }                                                                         \
+    MIDA_INLINE size_t _name##_length(const _type *vec)                       \
+    {                                                                         \
+        return vec ? MIDA(const _container, vec)->length : 0;                 \
+    }                                                                         \
+    MIDA_INLINE int _name##_reserve(_type **p_vec, const size_t capacity)     \
+    {                                                                         \
+        const size_t length = _name##_length(*p_vec),                         \
+                     current =                                                \
+                         *p_vec ? MIDA(_container, *p_vec)->capacity : 0;     \
+        size_t grown = current * 2 > capacity ? current * 2 : capacity;       \
+        _type *vec;                                                           \
+        if (*p_vec && capacity <= current) return 0;                          \
+        if (grown < 8) grown = 8;                                             \
+        vec =                                                                 \
+            (_type *)mida_realloc(_container, *p_vec, sizeof(_type), grown);  \
+        if (!vec) return -1;                                                  \
+        MIDA(_container, vec)->length = length;                               \
+        MIDA(_container, vec)->capacity = grown;                              \
+        *p_vec = vec;                                                         \
+        return 0;                                                             \
+    }                                                                         \
+    MIDA_INLINE int _name##_push(_type **p_vec, const _type value)            \
+    {                                                                         \
+        _container *container = *p_vec ? MIDA(_container, *p_vec) : NULL;     \
+        if (!container || container->length == container->capacity) {         \
+            if (_name##_reserve(p_vec, _name##_length(*p_vec) + 1))           \
+                return -1;                                                    \
+            container = MIDA(_container, *p_vec);                             \
+        }                                                                     \
+        (*p_vec)[container->length++] = value;                                \
+        return 0;                                                             \
+    }                                                                         \
+    MIDA_INLINE _type _name##_get(const _type *vec, const size_t index)       \
+    {                                                                         \
+        return vec[index];                                                    \
+    }                                                                         \
+    MIDA_INLINE int _name##_resize(_type **p_vec, const size_t length)        \
+    {                                                                         \
+        const size_t old = _name##_length(*p_vec);                            \
+        if (_name##_reserve(p_vec, length)) return -1;                        \
+        if (length > old)                                                     \
+            memset(*p_vec + old, 0, (length - old) * sizeof(_type));          \
+        MIDA(_container, *p_vec)->length = length;                            \
+        return 0;                                                             \
+    }                                                                         \
+    MIDA_INLINE void _name##_sort_range(                                      \
+        _type *vec, size_t n, int (*cmp)(const _type *, const _type *))       \
+    {                                                                         \
+        _type pivot, swap;                                                    \
+        size_t i, j;                                                          \
+        while (n > 16) {                                                      \
+            const size_t mid = n / 2;                                         \
+            if (cmp(&vec[mid], &vec[0]) < 0)                                  \
+                swap = vec[mid], vec[mid] = vec[0], vec[0] = swap;            \
+            if (cmp(&vec[n - 1], &vec[0]) < 0)                                \
+                swap = vec[n - 1], vec[n - 1] = vec[0], vec[0] = swap;        \
+            if (cmp(&vec[n - 1], &vec[mid]) < 0)                              \
+                swap = vec[n - 1], vec[n - 1] = vec[mid], vec[mid] = swap;    \
+            pivot = vec[mid];                                                 \
+            for (i = 0, j = n - 1;; ++i, --j) {                               \
+                while (cmp(&vec[i], &pivot) < 0) ++i;                         \
+                while (cmp(&pivot, &vec[j]) < 0) --j;                         \
+                if (i >= j) break;                                            \
+                swap = vec[i], vec[i] = vec[j], vec[j] = swap;                \
+            }                                                                 \
+            if (j + 1 < n - j - 1) {                                          \
+                _name##_sort_range(vec, j + 1, cmp);                          \
+                vec += j + 1;                                                 \
+                n -= j + 1;                                                   \
+            }                                                                 \
+            else {                                                            \
+                _name##_sort_range(vec + j + 1, n - j - 1, cmp);              \
+                n = j + 1;                                                    \
+            }                                                                 \
+        }                                                                     \
+        for (i = 1; i < n; ++i) {                                             \
+            pivot = vec[i];                                                   \
+            for (j = i; j > 0 && cmp(&pivot, &vec[j - 1]) < 0; --j)           \
+                vec[j] = vec[j - 1];                                          \
+            vec[j] = pivot;                                                   \
+        }                                                                     \
+    }                                                                         \
+    MIDA_INLINE void _name##_sort(_type *vec,                                 \
+                                  int (*cmp)(const _type *, const _type *))   \
+    {                                                                         \
+        _name##_sort_range(vec, _name##_length(vec), cmp);                    \
+    }                                                                         \
+    MIDA_INLINE _type *_name##_find(_type *vec,                               \
+                                    const _type *value,                       \
+                                    int (*cmp)(const _type *, const _type *)) \
+    {                                                                         \
+        const size_t length = _name##_length(vec);                            \
+        size_t i;                                                             \
+        for (i = 0; i < length; ++i)                                          \
+            if (cmp ? !cmp(&vec[i], value)                                    \
+                    : !memcmp(&vec[i], value, sizeof(_type)))                 \
+                return &vec[i];                                               \
+        return NULL;                                                          \
+    }                                                                         \
+    MIDA_INLINE void _name##_free(_type *vec)                                 \
+    {                                                                         \
+        if (vec) mida_free(_container, vec);                                  \
+    }
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+/**
+ * @brief Starts the thread pool running mida_parallel_for() and
+ *      mida_parallel_reduce()
+ *
+ * Called implicitly with 0 by the first parallel call. The calling thread
+ * takes part in every job, so `threads - 1` workers are created.
+ *
+ * @param threads Amount of threads to split jobs across, 0 for one per
+ *      online CPU
+ * @return 0 on success, -1 if already running or a thread couldn't be
+ *      created
+ */
+MIDA_API int mida_parallel_start(unsigned threads);
+
+/**
+ * @brief Waits for the running job and stops the thread pool
+ */
+MIDA_API void mida_parallel_stop(void);
+
+MIDA_API void __mida_parallel_for(void *base,
+                                  const size_t length,
+                                  size_t chunk,
+                                  void (*fn)(void *base,
+                                             size_t first,
+                                             size_t last,
+                                             void *context),
+                                  void *context);
+
+MIDA_API void __mida_parallel_reduce(
+    void *base,
+    const size_t length,
+    size_t chunk,
+    void *result,
+    const size_t size,
+    void (*fn)(
+        void *base, size_t first, size_t last, void *partial, void *context),
+    void (*combine)(void *result, const void *partial, void *context),
+    void *context);
+
+/**
+ * @def mida_parallel_for(_container, _base, _chunk, _fn, _context)
+ * @brief Calls `_fn(base, first, last, context)` over chunks of an array,
+ *      across the thread pool
+ *
+ * The array is split by the `length` stored in its container into chunks of
+ * `_chunk` elements, spread evenly over the threads; threads running out of
+ * chunks steal half of the chunks left to another one. Returns once every
+ * chunk is done. A call made while the pool is busy, e.g. from inside
+ * `_fn`, runs serially on the calling thread.
+ *
+ * @param _container Type of the container structure, with a `size_t length`
+ *      member
+ * @param _base Pointer to the data (not the container)
+ * @param _chunk Amount of elements per call to `_fn`, 0 to pick one
+ * @param _fn Function processing elements `[first, last)`
+ * @param _context User data passed to `_fn`
+ */
+#define mida_parallel_for(_container, _base, _chunk, _fn, _context)           \
+    __mida_parallel_for((_base),                                              \
+                        (_base) ? MIDA(_container, _base)->length : 0,        \
+                        _chunk, _fn, _context)
+
+/**
+ * @def mida_parallel_reduce(_container, _base, _chunk, _result, _fn,
+ *      _combine, _context)
+ * @brief Reduces an array into `*_result` across the thread pool
+ *
+ * Every thread accumulates the chunks it runs into its own partial result,
+ * which starts as a copy of `*_result`, with
+ * `_fn(base, first, last, partial, context)`. The partial results are then
+ * merged in order into `*_result` on the calling thread with
+ * `_combine(result, partial, context)`. `*_result` must thus hold the
+ * identity of the reduction on entry, e.g. 0 for a sum.
+ *
+ * @param _container Type of the container structure, with a `size_t length`
+ *      member
+ * @param _base Pointer to the data (not the container)
+ * @param _chunk Amount of elements per call to `_fn`, 0 to pick one
+ * @param _result Pointer to the result
+ * @param _fn Function accumulating elements `[first, last)` into `partial`
+ * @param _combine Function merging a partial result into `result`
+ * @param _context User data passed to `_fn` and `_combine`
+ */
+#define mida_parallel_reduce(_container, _base, _chunk, _result, _fn,         \
+                             _combine, _context)                              \
+    __mida_parallel_reduce((_base),                                           \
+                           (_base) ? MIDA(_container, _base)->length : 0,     \
+                           _chunk, (_result), sizeof *(_result), _fn,         \
+                           _combine, _context)
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+/**
+ * @struct mida_agg
+ * @brief Cached aggregates of an array of doubles, embedded in its container
+ *
+ * Zero-initialize it, e.g. with mida_calloc(). The aggregates are computed
+ * by the first query and kept until the array is modified through
+ * mida_agg_set() or mida_agg_touch(), or its length changes.
+ */
+struct mida_agg {
+    /** Bumped on every modification */
+    unsigned long version;
+    /** `version + 1` at the time the aggregates were computed, 0 if never */
+    unsigned long cached;
+    /** Length at the time the aggregates were computed */
+    size_t length;
+    /** Sum of the elements, 0 if empty */
+    double sum;
+    /** Smallest element, 0 if empty */
+    double min;
+    /** Largest element, 0 if empty */
+    double max;
+    /** Average of the elements, 0 if empty */
+    double mean;
+};
+
+MIDA_API const struct mida_agg *__mida_agg(struct mida_agg *agg,
+                                           const double *base,
+                                           const size_t length);
+
+/**
+ * @def mida_agg(_container, _field, _base)
+ * @brief Gets the aggregates of an array of doubles, computing them in a
+ *      single vectorized pass if the cached ones are outdated
+ *
+ * @param _container Type of the container structure, with a `size_t length`
+ *      member
+ * @param _field Name of the `struct mida_agg` member of the container
+ * @param _base Pointer to the data (not the container)
+ * @return Pointer to the up to date `struct mida_agg`
+ */
+#define mida_agg(_container, _field, _base)                                   \
+    __mida_agg(&MIDA(_container, _base)->_field, (_base),                     \
+               MIDA(_container, _base)->length)
+
+/**
+ * @def mida_agg_sum(_container, _field, _base)
+ * @brief Gets the sum of an array of doubles, see mida_agg()
+ */
+#define mida_agg_sum(_container, _field, _base)                               \
+    (mida_agg(_container, _field, _base)->sum)
+
+/**
+ * @def mida_agg_min(_container, _field, _base)
+ * @brief Gets the smallest element of an array of doubles, see mida_agg()
+ */
+#define mida_agg_min(_container, _field, _base)                               \
+    (mida_agg(_container, _field, _base)->min)
+
+/**
+ * @def mida_agg_max(_container, _field, _base)
+ * @brief Gets the largest element of an array of doubles, see mida_agg()
+ */
+#define mida_agg_max(_container, _field, _base)                               \
+    (mida_agg(_container, _field, _base)->max)
+
+/**
+ * @def mida_agg_mean(_container, _field, _base)
+ * @brief Gets the average of an array of doubles, see mida_agg()
+ */
+#define mida_agg_mean(_container, _field, _base)                              \
+    (mida_agg(_container, _field, _base)->mean)
+
+/**
+ * @struct mida_agg_int
+ * @brief Cached aggregates of an array of `int` or `int64_t`, embedded in
+ *      its container
+ *
+ * The integer counterpart of struct mida_agg, kept up to date the same way.
+ * The sum is accumulated in 64 bits, so that of `int` elements cannot
+ * overflow; that of `int64_t` elements wraps around like in plain C.
+ */
+struct mida_agg_int {
+    /** Bumped on every modification */
+    unsigned long version;
+    /** `version + 1` at the time the aggregates were computed, 0 if never */
+    unsigned long cached;
+    /** Length at the time the aggregates were computed */
+    size_t length;
+    /** Sum of the elements, 0 if empty */
+    int64_t sum;
+    /** Smallest element, 0 if empty */
+    int64_t min;
+    /** Largest element, 0 if empty */
+    int64_t max;
+    /** Average of the elements, 0 if empty */
+    double mean;
+};
+
+MIDA_API const struct mida_agg_int *__mida_agg_int(struct mida_agg_int *agg,
+                                                   const int *base,
+                                                   const size_t length);
+
+MIDA_API const struct mida_agg_int *
+__mida_agg_int64(struct mida_agg_int *agg,
+                 const int64_t *base,
+                 const size_t length);
+
+/**
+ * @def mida_agg_int(_container, _field, _base)
+ * @brief Gets the aggregates of an array of `int`, see mida_agg()
+ *
+ * @param _container Type of the container structure, with a `size_t length`
+ *      member
+ * @param _field Name of the `struct mida_agg_int` member of the container
+ * @param _base Pointer to the data (not the container)
+ * @return Pointer to the up to date `struct mida_agg_int`
+ */
+#define mida_agg_int(_container, _field, _base)                               \
+    __mida_agg_int(&MIDA(_container, _base)->_field, (_base),                 \
+                   MIDA(_container, _base)->length)
+
+/**
+ * @def mida_agg_int64(_container, _field, _base)
+ * @brief Gets the aggregates of an array of `int64_t`, see mida_agg()
+ *
+ * @param _container Type of the container structure, with a `size_t length`
+ *      member
+ * @param _field Name of the `struct mida_agg_int` member of the container
+ * @param _base Pointer to the data (not the container)
+ * @return Pointer to the up to date `struct mida_agg_int`
+ */
+#define mida_agg_int64(_container, _field, _base)                             \
+    __mida_agg_int64(&MIDA(_container, _base)->_field, (_base),               \
+                     MIDA(_container, _base)->length)
+
+/**
+ * @def mida_agg_touch(_container, _field, _base)
+ * @brief Invalidates the cached aggregates after modifying elements in place
+ *
+ * @param _container Type of the container structure
+ * @param _field Name of the `struct mida_agg` or `struct mida_agg_int` member
+ *      of the container
+ * @param _base Pointer to the data (not the container)
+ */
+#define mida_agg_touch(_container, _field, _base)                             \
+    ((void)++MIDA(_container, _base)->_field.version)
+
+/**
+ * @def mida_agg_set(_container, _field, _base, _index, _value)
+ * @brief Sets an element and invalidates the cached aggregates
+ *
+ * @param _container Type of the container structure
+ * @param _field Name of the `struct mida_agg` or `struct mida_agg_int` member
+ *      of the container
+ * @param _base Pointer to the data (not the container)
+ * @param _index Index of the element
+ * @param _value The new value
+ */
+#define mida_agg_set(_container, _field, _base, _index, _value)               \
+    ((_base)[_index] = (_value), mida_agg_touch(_container, _field, _base))
+
+#ifndef MIDA_COLUMN_BLOCK
+#define MIDA_COLUMN_BLOCK 1024
+#endif /* MIDA_COLUMN_BLOCK */
+
+/**
+ * @def MIDA_COLUMN_NULL
+ * @brief Value marking a missing element of a column, never matched by a
+ *      scan
+ */
+#define MIDA_COLUMN_NULL INT64_MIN
+
+/**
+ * @struct mida_zone
+ * @brief Zone map of a block of MIDA_COLUMN_BLOCK elements of a column
+ */
+struct mida_zone {
+    /** Smallest non-null element, INT64_MAX if none */
+    int64_t min;
+    /** Largest non-null element, INT64_MIN if none */
+    int64_t max;
+    /** Amount of null elements */
+    size_t nulls;
+};
+
+/**
+ * @struct mida_column
+ * @brief Container of an int64_t column, created with mida_column_new()
+ */
+struct mida_column {
+    /** Amount of elements */
+    size_t length;
+    /** Amount of elements allocated */
+    size_t capacity;
+    /** Zone maps of the blocks, kept up to date by every write */
+    struct mida_zone *zones;
+};
+
+/**
+ * @brief Creates an empty int64_t column
+ *
+ * @param capacity Amount of elements to allocate room for
+ * @return Pointer to the data, NULL on failure
+ */
+MIDA_API int64_t *mida_column_new(const size_t capacity);
+
+/**
+ * @brief Gets the amount of elements of a column
+ *
+ * @param column The column, or NULL
+ * @return Amount of elements
+ */
+MIDA_API size_t mida_column_length(const int64_t *column);
+
+/**
+ * @brief Appends an element to a column, creating it if NULL
+ *
+ * @param p_column Pointer to the column, which may be moved
+ * @param value The element, or MIDA_COLUMN_NULL
+ * @return 0 on success, -1 on failure
+ */
+MIDA_API int mida_column_push(int64_t **p_column, const int64_t value);
+
+/**
+ * @brief Replaces an element of a column
+ *
+ * Elements must not be assigned directly, as the zone map of their block
+ * would go stale. Replacing the smallest or largest element of a block
+ * rescans it.
+ *
+ * @param column The column
+ * @param index Index of the element
+ * @param value The element, or MIDA_COLUMN_NULL
+ */
+MIDA_API void mida_column_set(int64_t *column,
+                              const size_t index,
+                              const int64_t value);
+
+/**
+ * @brief Calls `fn(index, value, context)` for each element of a column
+ *      within `[lo, hi]`, in order
+ *
+ * Blocks whose zone map rules out any match are skipped without being read,
+ * the others are compared with AVX2 when the CPU supports it.
+ *
+ * @param column The column
+ * @param lo Smallest matching value
+ * @param hi Largest matching value
+ * @param fn Function called for each matching element, or NULL to only
+ *      count them
+ * @param context User data passed to `fn`
+ * @return Amount of matching elements
+ */
+MIDA_API size_t mida_column_scan(const int64_t *column,
+                                 int64_t lo,
+                                 const int64_t hi,
+                                 void (*fn)(size_t index,
+                                            int64_t value,
+                                            void *context),
+                                 void *context);
+
+/**
+ * @brief Frees a column and its zone maps
+ *
+ * @param column The column, or NULL
+ */
+MIDA_API void mida_column_free(int64_t *column);
+
+/**
+ * @def MIDA_PACK_BLOCK
+ * @brief Amount of values encoded together in a packed array
+ */
+#define MIDA_PACK_BLOCK 128
+
+/** Values stored as their offset from the smallest one of their block */
+#define MIDA_PACK_FOR 0
+/** Values stored as their difference from the previous one, for sorted or
+ * slowly changing sequences */
+#define MIDA_PACK_DELTA 1
+
+/**
+ * @struct mida_pack_block
+ * @brief Encoding of a block of MIDA_PACK_BLOCK values of a packed array
+ */
+struct mida_pack_block {
+    /** Smallest value (MIDA_PACK_FOR) or difference (MIDA_PACK_DELTA) */
+    int64_t reference;
+    /** First value of the block */
+    int64_t first;
+    /** Index of the first word of the block in the packed array */
+    size_t offset;
+    /** Bits per value, the block takes `2 * width` words */
+    unsigned char width;
+    /** MIDA_PACK_FOR or MIDA_PACK_DELTA */
+    unsigned char encoding;
+};
+
+/**
+ * @struct mida_packed
+ * @brief Container of a packed array, created with mida_pack()
+ */
+struct mida_packed {
+    /** Amount of values */
+    size_t length;
+    /** Amount of 64-bit words of packed values */
+    size_t words;
+    /** Encoding of each block */
+    struct mida_pack_block *blocks;
+};
+
+/**
+ * @brief Encodes integers into a bit-packed array
+ *
+ * Every block of MIDA_PACK_BLOCK values is stored with as few bits per value
+ * as it needs, either as offsets from its smallest value or as differences
+ * between consecutive values, whichever is narrower. Timestamps or sorted
+ * ids typically take a few bits each instead of 64.
+ *
+ * @param values The values
+ * @param length Amount of values
+ * @return Pointer to the packed words, NULL on failure
+ */
+MIDA_API uint64_t *mida_pack(const int64_t *values, const size_t length);
+
+/**
+ * @brief Gets the amount of values of a packed array
+ *
+ * @param packed The packed array, or NULL
+ * @return Amount of values
+ */
+MIDA_API size_t mida_pack_length(const uint64_t *packed);
+
+/**
+ * @brief Gets a value of a packed array
+ *
+ * Takes constant time for MIDA_PACK_FOR blocks, and adds up to
+ * MIDA_PACK_BLOCK differences for MIDA_PACK_DELTA ones.
+ *
+ * @param packed The packed array
+ * @param index Index of the value
+ * @return The value
+ */
+MIDA_API int64_t mida_pack_get(const uint64_t *packed, const size_t index);
+
+/**
+ * @brief Decodes a block of a packed array
+ *
+ * @param packed The packed array
+ * @param block Index of the block, i.e. of its first value divided by
+ *      MIDA_PACK_BLOCK
+ * @param values Room for MIDA_PACK_BLOCK values
+ * @return Amount of values decoded, less than MIDA_PACK_BLOCK for the last
+ *      block
+ */
+MIDA_API size_t mida_pack_decode_block(const uint64_t *packed,
+                                       const size_t block,
+                                       int64_t *values);
+
+/**
+ * @brief Decodes a range of values of a packed array
+ *
+ * @param packed The packed array
+ * @param first Index of the first value
+ * @param count Amount of values to decode
+ * @param values Room for `count` values
+ * @return Amount of values decoded, less than `count` past the end
+ */
+MIDA_API size_t mida_pack_decode(const uint64_t *packed,
+                                 const size_t first,
+                                 size_t count,
+                                 int64_t *values);
+
+/**
+ * @brief Frees a packed array and its block table
+ *
+ * @param packed The packed array, or NULL
+ */
+MIDA_API void mida_pack_free(uint64_t *packed);
+
+/**
+ * @struct mida_pack_iter
+ * @brief Iterator over a packed array, decoding a block at a time
+ */
+struct mida_pack_iter {
+    const uint64_t *packed;
+    size_t index;
+    size_t length;
+    int64_t values[MIDA_PACK_BLOCK];
+};
+
+/**
+ * @brief Initializes an iterator over a packed array
+ *
+ * @param iter The iterator
+ * @param packed The packed array, or NULL
+ */
+MIDA_INLINE void
+mida_pack_iter_init(struct mida_pack_iter *iter, const uint64_t *packed)
+{
+    iter->packed = packed;
+    iter->index = 0;
+    iter->length = mida_pack_length(packed);
+}
+
+/**
+ * @brief Gets the next value of a packed array
+ *
+ * @param iter The iterator
+ * @param value Where to store the value
+ * @return 1 if a value was stored, 0 at the end
+ */
+MIDA_INLINE int
+mida_pack_iter_next(struct mida_pack_iter *iter, int64_t *value)
+{
+    const size_t at = iter->index % MIDA_PACK_BLOCK;
+
+    if (iter->index == iter->length) return 0;
+    if (!at)
+        mida_pack_decode_block(iter->packed, iter->index / MIDA_PACK_BLOCK,
+                               iter->values);
+    *value = iter->values[at];
+    ++iter->index;
+    return 1;
+}
+
+#ifndef MIDA_HEADER
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#define __mida_data_from_container(_container_ptr, _container_size)           \
+    ((mida_byte *)_container_ptr + _container_size)
+#define __mida_container_from_data(_data_ptr, _container_size)                \
+    (void *)((mida_byte *)_data_ptr - _container_size)
+
+MIDA_API void *
+__mida_malloc(const size_t container_size,
+              const size_t element_size,
+              const size_t count)
+{
+    const size_t data_size = element_size * count,
+                 total_size = container_size + data_size;
+    mida_byte *container = malloc(total_size);
+    return !container ? NULL
+                      : __mida_data_from_container(container, container_size);
+}
+
+MIDA_API void *
+__mida_calloc(const size_t container_size,
+              const size_t element_size,
+              const size_t count)
+{
+    const size_t data_size = element_size * count,
+                 total_size = container_size + data_size;
+    mida_byte *container = calloc(1, total_size);
+    return !container ? NULL
+                      : __mida_data_from_container(container, container_size);
+}
+
+MIDA_API void *
+__mida_realloc(const size_t container_size,
+               void *base,
+               const size_t element_size,
+               const size_t count)
+{
+    if (base) {
+        const size_t data_size = element_size * count,
+                     total_size = container_size + data_size;
+        mida_byte *original_container =
+            __mida_container_from_data(base, container_size);
+        mida_byte *container = realloc(original_container, total_size);
+        return !container
+                   ? NULL
+                   : __mida_data_from_container(container, container_size);
+    }
+    return __mida_malloc(container_size, element_size, count);
+}
+
+MIDA_API void *
+__mida_nwrap(const size_t container_size,
+             void *data,
+             const size_t size,
+             mida_byte *const container)
+{
+    return memcpy(__mida_data_from_container(container, container_size), data,
+                  size);
+}
+
+#ifdef MIDA_WITH_POSIX
+
+MIDA_API void
+mida_chain_init(struct mida_chain *chain)
+{
+    memset(chain, 0, sizeof *chain);
+}
+
+MIDA_API void
+mida_chain_cleanup(struct mida_chain *chain)
+{
+    free(chain->iov);
+    memset(chain, 0, sizeof *chain);
+}
+
+static int
+__mida_chain_reserve(struct mida_chain *chain, const int front)
+{
+    size_t capacity = chain->capacity, head;
+
+    if (front ? chain->head > 0 : chain->head + chain->count < capacity)
+        return 0;
+    if (chain->count >= capacity / 2) {
+        struct iovec *iov;
+
+        capacity = capacity ? capacity * 2 : 8;
+        if (!(iov = realloc(chain->iov, capacity * sizeof *iov))) return -1;
+        chain->iov = iov;
+        chain->capacity = capacity;
+    }
+    head = (capacity - chain->count) / 2;
+    memmove(chain->iov + head, chain->iov + chain->head,
+            chain->count * sizeof *chain->iov);
+    chain->head = head;
+    return 0;
+}
+
+MIDA_API int
+mida_chain_append(struct mida_chain *chain,
+                  const void *base,
+                  const size_t size)
+{
+    struct iovec *iov;
+
+    if (__mida_chain_reserve(chain, 0) != 0) return -1;
+    iov = &chain->iov[chain->head + chain->count++];
+    iov->iov_base = (void *)base;
+    iov->iov_len = size;
+    chain->length += size;
+    return 0;
+}
+
+MIDA_API int
+mida_chain_prepend(struct mida_chain *chain,
+                   const void *base,
+                   const size_t size)
+{
+    struct iovec *iov;
+
+    if (__mida_chain_reserve(chain, 1) != 0) return -1;
+    iov = &chain->iov[--chain->head];
+    ++chain->count;
+    iov->iov_base = (void *)base;
+    iov->iov_len = size;
+    chain->length += size;
+    return 0;
+}
+
+MIDA_API void
+mida_chain_consume(struct mida_chain *chain, size_t size)
+{
+    while (size && chain->count) {
+        struct iovec *iov = &chain->iov[chain->head];
+
+        if (size < iov->iov_len) {
+            iov->iov_base = (mida_byte *)iov->iov_base + size;
+            iov->iov_len -= size;
+            chain->length -= size;
+            return;
+        }
+        size -= iov->iov_len;
+        chain->length -= iov->iov_len;
+        ++chain->head;
+        --chain->count;
+    }
+    if (!chain->count) chain->head = chain->capacity / 2;
+}
+
+MIDA_API const struct iovec *
+mida_chain_iov(const struct mida_chain *chain, int *iovcnt)
+{
+    *iovcnt = chain->count > MIDA_IOV_MAX ? MIDA_IOV_MAX : (int)chain->count;
+    return chain->iov ? chain->iov + chain->head : NULL;
+}
+
+MIDA_API ssize_t
+mida_chain_writev(struct mida_chain *chain, int fd)
+{
+    int iovcnt;
+    const struct iovec *iov = mida_chain_iov(chain, &iovcnt);
+    ssize_t written;
+
+    if (!iovcnt) return 0;
+    if ((written = writev(fd, iov, iovcnt)) > 0)
+        mida_chain_consume(chain, (size_t)written);
+    return written;
+}
+
+MIDA_API ssize_t
+mida_chain_sendmsg(struct mida_chain *chain, int fd, int flags)
+{
+    struct msghdr msg;
+    int iovcnt;
+    ssize_t sent;
+
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = (struct iovec *)mida_chain_iov(chain, &iovcnt);
+    msg.msg_iovlen = iovcnt;
+    if (!iovcnt) return 0;
+    if ((sent = sendmsg(fd, &msg, flags)) > 0)
+        mida_chain_consume(chain, (size_t)sent);
+    return sent;
+}
+
+#endif /* MIDA_WITH_POSIX */
+
+/* the buffer starts right after the container, which is moved along with
+ * the start of the window; no bytes are copied but its own */
+#define __mida_pkb_buffer(_pkb)                                               \
+    ((mida_byte *)(_pkb) + sizeof(struct mida_pkb) - (_pkb)->head)
+
+static void *
+__mida_pkb_move(struct mida_pkb *pkb, const size_t head)
+{
+    mida_byte *data = __mida_pkb_buffer(pkb) + head;
+
+    memmove(data - sizeof *pkb, pkb, sizeof *pkb);
+    pkb = (struct mida_pkb *)(data - sizeof *pkb);
+    pkb->head = head;
+    return data;
+}
+
+MIDA_API void *
+mida_pkb_malloc(const size_t size, const size_t headroom)
+{
+    struct mida_pkb *pkb;
+    mida_byte *buffer;
+
+    if (headroom > size || size > (size_t)-1 - sizeof *pkb) return NULL;
+    if (!(buffer = malloc(sizeof *pkb + size))) return NULL;
+    pkb = (struct mida_pkb *)(buffer + headroom);
+    pkb->head = headroom;
+    pkb->length = 0;
+    pkb->size = size;
+    pkb->flags = 0;
+    return buffer + headroom + sizeof *pkb;
+}
+
+MIDA_API void
+mida_pkb_free(void *data)
+{
+    struct mida_pkb *pkb;
+
+    if (!data) return;
+    pkb = MIDA(struct mida_pkb, data);
+    free(__mida_pkb_buffer(pkb) - sizeof *pkb);
+}
+
+MIDA_API void *
+mida_pkb_reserve(void *data, const size_t size)
+{
+    struct mida_pkb *pkb = MIDA(struct mida_pkb, data);
+
+    if (pkb->length || size > pkb->size - pkb->head) return NULL;
+    return __mida_pkb_move(pkb, pkb->head + size);
+}
+
+MIDA_API void *
+mida_push(void *data, const size_t size)
+{
+    struct mida_pkb *pkb = MIDA(struct mida_pkb, data);
+
+    if (size > pkb->head) return NULL;
+    pkb->length += size;
+    return __mida_pkb_move(pkb, pkb->head - size);
+}
+
+MIDA_API void *
+mida_pull(void *data, const size_t size)
+{
+    struct mida_pkb *pkb = MIDA(struct mida_pkb, data);
+
+    if (size > pkb->length) return NULL;
+    pkb->length -= size;
+    return __mida_pkb_move(pkb, pkb->head + size);
+}
+
+MIDA_API void *
+mida_put(void *data, const size_t size)
+{
+    struct mida_pkb *pkb = MIDA(struct mida_pkb, data);
+    mida_byte *tail = (mida_byte *)data + pkb->length;
+
+    if (size > pkb->size - pkb->head - pkb->length) return NULL;
+    pkb->length += size;
+    return tail;
+}
+
+MIDA_API void
+mida_trim(void *data, const size_t length)
+{
+    struct mida_pkb *pkb = MIDA(struct mida_pkb, data);
+
+    if (length < pkb->length) pkb->length = length;
+}
+
+#undef __mida_pkb_buffer
+
+#ifdef MIDA_WITH_ATOMICS
+
+static size_t
+__mida_pow2(size_t n)
+{
+    size_t pow2 = 1;
+
+    while (pow2 < n)
+        pow2 <<= 1;
+    return pow2;
+}
+
+MIDA_API int
+mida_mpmc_init(struct mida_mpmc *q, size_t capacity)
+{
+    size_t i;
+
+    memset(q, 0, sizeof *q);
+    capacity = __mida_pow2(capacity < 2 ? 2 : capacity);
+    if (!(q->cells = malloc(capacity * sizeof *q->cells))) return -1;
+    for (i = 0; i < capacity; ++i) {
+        q->cells[i].seq = i;
+        q->cells[i].data = NULL;
+    }
+    q->mask = capacity - 1;
+    return 0;
+}
+
+MIDA_API void
+mida_mpmc_cleanup(struct mida_mpmc *q)
+{
+    free(q->cells);
+    memset(q, 0, sizeof *q);
+}
+
+MIDA_API int
+mida_mpmc_push(struct mida_mpmc *q, void *base)
+{
+    size_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    struct mida_mpmc_cell *cell;
+
+    for (;;) {
+        size_t seq;
+        ptrdiff_t diff;
+
+        cell = &q->cells[pos & q->mask];
+        seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return -1;
+        else
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+    cell->data = base;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+MIDA_API void *
+mida_mpmc_pop(struct mida_mpmc *q)
+{
+    size_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    struct mida_mpmc_cell *cell;
+    void *base;
+
+    for (;;) {
+        size_t seq;
+        ptrdiff_t diff;
+
+        cell = &q->cells[pos & q->mask];
+        seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return NULL;
+        else
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+    base = cell->data;
+    __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return base;
+}
+
+MIDA_API int
+mida_spsc_init(struct mida_spsc *q, size_t capacity)
+{
+    memset(q, 0, sizeof *q);
+    capacity = __mida_pow2(capacity < 2 ? 2 : capacity);
+    if (!(q->cells = calloc(capacity, sizeof *q->cells))) return -1;
+    q->mask = capacity - 1;
+    return 0;
+}
+
+MIDA_API void
+mida_spsc_cleanup(struct mida_spsc *q)
+{
+    free(q->cells);
+    memset(q, 0, sizeof *q);
+}
+
+MIDA_API int
+mida_spsc_push(struct mida_spsc *q, void *base)
+{
+    const size_t tail = q->tail;
+
+    if (tail - q->head_cache > q->mask) {
+        q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        if (tail - q->head_cache > q->mask) return -1;
+    }
+    q->cells[tail & q->mask] = base;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+MIDA_API void *
+mida_spsc_pop(struct mida_spsc *q)
+{
+    const size_t head = q->head;
+    void *base;
+
+    if (head == q->tail_cache) {
+        q->tail_cache = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+        if (head == q->tail_cache) return NULL;
+    }
+    base = q->cells[head & q->mask];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return base;
+}
+
+MIDA_API void
+mida_mpsc_init(struct mida_mpsc *q)
+{
+    memset(q, 0, sizeof *q);
+    q->head = q->tail = &q->stub;
+}
+
+MIDA_API void
+__mida_mpsc_push(struct mida_mpsc *q, struct mida_qlink *link)
+{
+    struct mida_qlink *prev;
+
+    __atomic_store_n(&link->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->head, link, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, link, __ATOMIC_RELEASE);
+}
+
+MIDA_API void *
+__mida_mpsc_pop(struct mida_mpsc *q,
+                const size_t container_size,
+                const size_t link_offset)
+{
+    struct mida_qlink *tail = q->tail,
+                      *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (!next) {
+        if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return NULL;
+        __mida_mpsc_push(q, &q->stub);
+        if (!(next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE)))
+            return NULL;
+    }
+    q->tail = next;
+    return (mida_byte *)tail - link_offset + container_size;
+}
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifdef MIDA_WITH_ATOMICS
+
+#ifdef MIDA_WITH_POSIX
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif /* MIDA_WITH_POSIX */
+
+#define __MIDA_SPIN_MAX 64
+
+static void
+__mida_spin_lock(int *lock)
+{
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        unsigned spins = 0;
+
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+#ifdef MIDA_WITH_POSIX
+            /* the holder may be preempted, give it the CPU back */
+            if (++spins == __MIDA_SPIN_MAX) {
+                sched_yield();
+                spins = 0;
+            }
+#else
+            (void)spins;
+#endif /* MIDA_WITH_POSIX */
+        }
+    }
+}
+
+#undef __MIDA_SPIN_MAX
+
+static void
+__mida_spin_unlock(int *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/* blocks are only recycled for containers of the same size, as the data
+ * starts right after the container: the idle blocks of a class are kept in
+ * one list per container size, whose first blocks are chained through
+ * `sizes`, so finding a block costs a step per distinct container size */
+struct __mida_pool_block {
+    /* next idle block with the same container size */
+    struct __mida_pool_block *next;
+    /* first idle block of the next container size, for first blocks only */
+    struct __mida_pool_block *sizes;
+    unsigned short sizeclass;
+    unsigned short trimmed;
+    unsigned container_size;
+};
+
+#define __mida_pool_block_size(_block)                                        \
+    (sizeof(struct __mida_pool_block) + (_block)->container_size              \
+     + ((size_t)1 << (MIDA_POOL_MIN_SHIFT + (_block)->sizeclass)))
+
+#define __mida_pool_block_from_data(_base, _container_size)                   \
+    ((struct __mida_pool_block *)((mida_byte *)(_base) - (_container_size)   \
+                                  - sizeof(struct __mida_pool_block)))
+
+static int
+__mida_pool_class(const size_t size)
+{
+    int sizeclass = 0;
+
+    while (((size_t)1 << (MIDA_POOL_MIN_SHIFT + sizeclass)) < size)
+        if (++sizeclass == MIDA_POOL_CLASSES) return -1;
+    return sizeclass;
+}
+
+/* both to be called with the lock of the class held */
+static void
+__mida_pool_push(struct mida_pool_class *class,
+                 struct __mida_pool_block *block)
+{
+    struct __mida_pool_block **link =
+        (struct __mida_pool_block **)&class->idle;
+
+    while (*link && (*link)->container_size != block->container_size)
+        link = &(*link)->sizes;
+    block->next = *link;
+    block->sizes = *link ? (*link)->sizes : NULL;
+    *link = block;
+}
+
+static struct __mida_pool_block *
+__mida_pool_pop(struct mida_pool_class *class, const size_t container_size)
+{
+    struct __mida_pool_block **link =
+        (struct __mida_pool_block **)&class->idle, *block;
+
+    while ((block = *link) && block->container_size != container_size)
+        link = &block->sizes;
+    if (!block) return NULL;
+    if (block->next) {
+        block->next->sizes = block->sizes;
+        *link = block->next;
+    }
+    else {
+        *link = block->sizes;
+    }
+    return block;
+}
+
+static struct __mida_pool_block *
+__mida_pool_block_new(struct mida_pool *pool,
+                      const size_t container_size,
+                      const int sizeclass)
+{
+    const size_t total = sizeof(struct __mida_pool_block) + container_size
+                         + ((size_t)1 << (MIDA_POOL_MIN_SHIFT + sizeclass));
+    size_t held = __atomic_add_fetch(&pool->held, total, __ATOMIC_RELAXED);
+    struct __mida_pool_block *block;
+
+    if ((pool->limit && held > pool->limit) || !(block = malloc(total))) {
+        __atomic_sub_fetch(&pool->held, total, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    block->sizeclass = (unsigned short)sizeclass;
+    block->trimmed = 0;
+    block->container_size = (unsigned)container_size;
+    return block;
+}
+
+MIDA_API void
+mida_pool_init(struct mida_pool *pool, const size_t limit)
+{
+    memset(pool, 0, sizeof *pool);
+    pool->limit = limit;
+}
+
+MIDA_API void
+mida_pool_cleanup(struct mida_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < MIDA_POOL_CLASSES; ++i) {
+        struct __mida_pool_block *first = pool->classes[i].idle, *sizes;
+
+        for (; first; first = sizes) {
+            struct __mida_pool_block *block = first, *next;
+
+            sizes = first->sizes;
+            for (; block; block = next) {
+                next = block->next;
+                __atomic_sub_fetch(&pool->held, __mida_pool_block_size(block),
+                                   __ATOMIC_RELAXED);
+                free(block);
+            }
+        }
+        pool->classes[i].idle = NULL;
+    }
+}
+
+MIDA_API void *
+__mida_pool_malloc(struct mida_pool *pool,
+                   const size_t container_size,
+                   const size_t size)
+{
+    const int sizeclass = __mida_pool_class(size);
+    struct mida_pool_class *class;
+    struct __mida_pool_block *block;
+    mida_byte *container;
+
+    if (sizeclass < 0) return NULL;
+    class = &pool->classes[sizeclass];
+    __mida_spin_lock(&class->lock);
+    block = __mida_pool_pop(class, container_size);
+    __mida_spin_unlock(&class->lock);
+    if (!block && !(block = __mida_pool_block_new(pool, container_size,
+                                                  sizeclass)))
+        return NULL;
+    block->next = block->sizes = NULL;
+    block->trimmed = 0;
+    container = (mida_byte *)(block + 1);
+    memset(container, 0, container_size);
+    return __mida_data_from_container(container, container_size);
+}
+
+MIDA_API void
+__mida_pool_free(struct mida_pool *pool,
+                 const size_t container_size,
+                 void *base)
+{
+    struct __mida_pool_block *block;
+    struct mida_pool_class *class;
+
+    if (!base) return;
+    block = __mida_pool_block_from_data(base, container_size);
+    class = &pool->classes[block->sizeclass];
+    __mida_spin_lock(&class->lock);
+    __mida_pool_push(class, block);
+    __mida_spin_unlock(&class->lock);
+}
+
+MIDA_API size_t
+__mida_pool_capacity(const size_t container_size, const void *base)
+{
+    const struct __mida_pool_block *block =
+        __mida_pool_block_from_data(base, container_size);
+    return (size_t)1 << (MIDA_POOL_MIN_SHIFT + block->sizeclass);
+}
+
+MIDA_API int
+__mida_pool_prefill(struct mida_pool *pool,
+                    const size_t container_size,
+                    const size_t size,
+                    size_t count)
+{
+    const int sizeclass = __mida_pool_class(size);
+    struct mida_pool_class *class;
+
+    if (sizeclass < 0) return -1;
+    class = &pool->classes[sizeclass];
+    while (count--) {
+        struct __mida_pool_block *block =
+            __mida_pool_block_new(pool, container_size, sizeclass);
+
+        if (!block) return -1;
+        memset(block + 1, 0,
+               container_size
+                   + ((size_t)1 << (MIDA_POOL_MIN_SHIFT + sizeclass)));
+        __mida_spin_lock(&class->lock);
+        __mida_pool_push(class, block);
+        __mida_spin_unlock(&class->lock);
+    }
+    return 0;
+}
+
+#if defined(MIDA_WITH_POSIX) && (defined(MADV_FREE) || defined(MADV_DONTNEED))
+
+/* advises the pages of the data of an idle block, leaving its container
+ * alone, and returns the amount of bytes advised */
+static size_t
+__mida_pool_trim_block(struct __mida_pool_block *block, const size_t page)
+{
+    const size_t data = (size_t)(block + 1) + block->container_size,
+                 start = (data + page - 1) & ~(page - 1),
+                 end = (data + ((size_t)1 << (MIDA_POOL_MIN_SHIFT
+                                              + block->sizeclass)))
+                       & ~(page - 1);
+
+    if (block->trimmed || end <= start) return 0;
+#ifdef MADV_FREE
+    if (madvise((void *)start, end - start, MADV_FREE) != 0)
+#endif /* MADV_FREE */
+#ifdef MADV_DONTNEED
+        if (madvise((void *)start, end - start, MADV_DONTNEED) != 0)
+#endif /* MADV_DONTNEED */
+            return 0;
+    block->trimmed = 1;
+    return end - start;
+}
+
+#endif /* MIDA_WITH_POSIX */
+
+MIDA_API size_t
+mida_pool_trim(struct mida_pool *pool)
+{
+    size_t advised = 0;
+#if defined(MIDA_WITH_POSIX) && (defined(MADV_FREE) || defined(MADV_DONTNEED))
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int i;
+
+    for (i = 0; i < MIDA_POOL_CLASSES; ++i) {
+        struct mida_pool_class *class = &pool->classes[i];
+        struct __mida_pool_block *first, *block;
+
+        __mida_spin_lock(&class->lock);
+        for (first = class->idle; first; first = first->sizes)
+            for (block = first; block; block = block->next)
+                advised += __mida_pool_trim_block(block, page);
+        __mida_spin_unlock(&class->lock);
+    }
+#else
+    (void)pool;
+#endif /* MIDA_WITH_POSIX */
+    return advised;
+}
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+struct __mida_thread {
+    struct __mida_thread *next;
+    int in_use;
+    void *deferred;
+    unsigned long state;
+    unsigned long nesting;
+    unsigned long retired;
+    void *limbo[3];
+    unsigned long limbo_epoch[3];
+};
+
+static struct __mida_thread *__mida_threads;
+static __thread struct __mida_thread *__mida_self;
+static pthread_key_t __mida_thread_key;
+static pthread_once_t __mida_thread_once = PTHREAD_ONCE_INIT;
+
+static void
+__mida_thread_release(void *arg)
+{
+    struct __mida_thread *self = arg;
+
+    __atomic_store_n(&self->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void
+__mida_thread_key_init(void)
+{
+    pthread_key_create(&__mida_thread_key, __mida_thread_release);
+}
+
+static struct __mida_thread *
+__mida_thread_self(void)
+{
+    struct __mida_thread *self;
+
+    if (__mida_self) return __mida_self;
+    pthread_once(&__mida_thread_once, __mida_thread_key_init);
+    for (self = __atomic_load_n(&__mida_threads, __ATOMIC_ACQUIRE); self;
+         self = self->next)
+    {
+        int expected = 0;
+
+        if (__atomic_compare_exchange_n(&self->in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (!self) {
+        if (!(self = calloc(1, sizeof *self))) return NULL;
+        self->in_use = 1;
+        self->next = __atomic_load_n(&__mida_threads, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&__mida_threads, &self->next, self,
+                                            1, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            continue;
+    }
+    pthread_setspecific(__mida_thread_key, self);
+    return __mida_self = self;
+}
+
+MIDA_API void
+__mida_free_deferred(void *container)
+{
+    struct __mida_thread *self = __mida_thread_self();
+    void *head;
+
+    if (!self) {
+        free(container);
+        return;
+    }
+    head = __atomic_load_n(&self->deferred, __ATOMIC_RELAXED);
+    do
+        *(void **)container = head;
+    while (!__atomic_compare_exchange_n(&self->deferred, &head, container, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+MIDA_API size_t
+mida_reclaim(void)
+{
+    struct __mida_thread *thread;
+    size_t count = 0;
+
+    for (thread = __atomic_load_n(&__mida_threads, __ATOMIC_ACQUIRE); thread;
+         thread = thread->next)
+    {
+        void *block =
+            __atomic_exchange_n(&thread->deferred, NULL, __ATOMIC_ACQUIRE);
+
+        while (block) {
+            void *next = *(void **)block;
+
+            free(block);
+            block = next;
+            ++count;
+        }
+    }
+    return count;
+}
+
+static pthread_mutex_t __mida_reclaimer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __mida_reclaimer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t __mida_reclaimer_thread;
+static unsigned long __mida_reclaimer_interval_ms;
+static int __mida_reclaimer_running;
+
+static void *
+__mida_reclaimer_run(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&__mida_reclaimer_lock);
+    while (__mida_reclaimer_running) {
+        struct timespec deadline;
+
+#ifdef CLOCK_REALTIME
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t)(__mida_reclaimer_interval_ms / 1000);
+        deadline.tv_nsec += (long)(__mida_reclaimer_interval_ms % 1000)
+                            * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000L;
+        }
+#else
+        /* clock_gettime() is hidden in strict ISO C builds, fall back to
+         * whole seconds */
+        deadline.tv_sec = time(NULL) + 1
+                          + (time_t)(__mida_reclaimer_interval_ms / 1000);
+        deadline.tv_nsec = 0;
+#endif /* CLOCK_REALTIME */
+        pthread_cond_timedwait(&__mida_reclaimer_cond, &__mida_reclaimer_lock,
+                               &deadline);
+        pthread_mutex_unlock(&__mida_reclaimer_lock);
+        mida_reclaim();
+        pthread_mutex_lock(&__mida_reclaimer_lock);
+    }
+    pthread_mutex_unlock(&__mida_reclaimer_lock);
+    return NULL;
+}
+
+MIDA_API int
+mida_reclaimer_start(const unsigned long interval_ms)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&__mida_reclaimer_lock);
+    if (!__mida_reclaimer_running) {
+        __mida_reclaimer_interval_ms = interval_ms;
+        __mida_reclaimer_running = 1;
+        if (pthread_create(&__mida_reclaimer_thread, NULL,
+                           __mida_reclaimer_run, NULL)
+            == 0)
+            ret = 0;
+        else
+            __mida_reclaimer_running = 0;
+    }
+    pthread_mutex_unlock(&__mida_reclaimer_lock);
+    return ret;
+}
+
+MIDA_API void
+mida_reclaimer_stop(void)
+{
+    pthread_mutex_lock(&__mida_reclaimer_lock);
+    if (!__mida_reclaimer_running) {
+        pthread_mutex_unlock(&__mida_reclaimer_lock);
+        return;
+    }
+    __mida_reclaimer_running = 0;
+    pthread_cond_signal(&__mida_reclaimer_cond);
+    pthread_mutex_unlock(&__mida_reclaimer_lock);
+    pthread_join(__mida_reclaimer_thread, NULL);
+    mida_reclaim();
+}
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+static unsigned long __mida_epoch;
+
+static void
+__mida_limbo_free(void *block)
+{
+    while (block) {
+        void *next = *(void **)block;
+
+        free(block);
+        block = next;
+    }
+}
+
+static size_t
+__mida_limbo_count(const void *block)
+{
+    size_t count = 0;
+
+    for (; block; block = *(void *const *)block)
+        ++count;
+    return count;
+}
+
+MIDA_API void
+mida_epoch_enter(void)
+{
+    struct __mida_thread *self = __mida_thread_self();
+
+    if (self->nesting++) return;
+    __atomic_store_n(&self->state,
+                     __atomic_load_n(&__mida_epoch, __ATOMIC_RELAXED) << 1 | 1,
+                     __ATOMIC_SEQ_CST);
+}
+
+MIDA_API void
+mida_epoch_exit(void)
+{
+    struct __mida_thread *self = __mida_self;
+
+    if (--self->nesting) return;
+    __atomic_store_n(&self->state, self->state & ~1UL, __ATOMIC_RELEASE);
+}
+
+static int
+__mida_epoch_advance(const unsigned long epoch)
+{
+    unsigned long expected = epoch;
+    struct __mida_thread *thread;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (thread = __atomic_load_n(&__mida_threads, __ATOMIC_ACQUIRE); thread;
+         thread = thread->next)
+    {
+        const unsigned long state =
+            __atomic_load_n(&thread->state, __ATOMIC_ACQUIRE);
+
+        if ((state & 1) && state >> 1 != epoch) return 0;
+    }
+    return __atomic_compare_exchange_n(&__mida_epoch, &expected, epoch + 1, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+           || expected != epoch;
+}
+
+MIDA_API size_t
+mida_epoch_collect(void)
+{
+    struct __mida_thread *self = __mida_thread_self();
+    unsigned long epoch = __atomic_load_n(&__mida_epoch, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    int i;
+
+    if (__mida_epoch_advance(epoch))
+        epoch = __atomic_load_n(&__mida_epoch, __ATOMIC_ACQUIRE);
+    for (i = 0; i < 3; ++i) {
+        if (self->limbo[i] && self->limbo_epoch[i] + 2 <= epoch) {
+            count += __mida_limbo_count(self->limbo[i]);
+            __mida_limbo_free(self->limbo[i]);
+            self->limbo[i] = NULL;
+        }
+    }
+    return count;
+}
+
+MIDA_API void
+__mida_retire(void *container)
+{
+    struct __mida_thread *self = __mida_thread_self();
+    const unsigned long epoch =
+        __atomic_load_n(&__mida_epoch, __ATOMIC_ACQUIRE);
+    const int i = (int)(epoch % 3);
+
+    if (self->limbo[i] && self->limbo_epoch[i] != epoch) {
+        __mida_limbo_free(self->limbo[i]);
+        self->limbo[i] = NULL;
+    }
+    *(void **)container = self->limbo[i];
+    self->limbo[i] = container;
+    self->limbo_epoch[i] = epoch;
+    if (++self->retired % MIDA_EPOCH_FREQ == 0) mida_epoch_collect();
+}
+
+MIDA_API size_t
+mida_epoch_synchronize(void)
+{
+    struct __mida_thread *self = __mida_thread_self();
+    size_t count = 0;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        const unsigned long epoch =
+            __atomic_load_n(&__mida_epoch, __ATOMIC_ACQUIRE);
+
+        while (!__mida_epoch_advance(epoch))
+            sched_yield();
+    }
+    for (i = 0; i < 3; ++i) {
+        count += __mida_limbo_count(self->limbo[i]);
+        __mida_limbo_free(self->limbo[i]);
+        self->limbo[i] = NULL;
+    }
+    return count;
+}
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+#ifdef MIDA_WITH_ATOMICS
+
+MIDA_API void
+__mida_meta_write_begin(void *container)
+{
+    struct mida_seqlock *lock = container;
+
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+MIDA_API void
+__mida_meta_write_end(void *container)
+{
+    struct mida_seqlock *lock = container;
+
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+}
+
+MIDA_API void
+__mida_meta_read(const void *container,
+                 void *copy,
+                 const size_t container_size)
+{
+    const struct mida_seqlock *lock = container;
+    unsigned long seq;
+
+    for (;;) {
+        if ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1)
+            continue;
+        memcpy(copy, container, container_size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&lock->seq, __ATOMIC_RELAXED) == seq) break;
+    }
+    ((struct mida_seqlock *)copy)->seq = seq;
+}
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#ifdef MIDA_WITH_ATOMICS
+
+MIDA_API int
+mida_handles_init(struct mida_handles *table,
+                  const uint32_t capacity,
+                  struct mida_pool *pool)
+{
+    uint32_t i;
+
+    memset(table, 0, sizeof *table);
+    if (!(table->slots = malloc(capacity * sizeof *table->slots))) return -1;
+    for (i = 0; i < capacity; ++i) {
+        table->slots[i].generation = 1;
+        table->slots[i].next_free = i + 2;
+        table->slots[i].base = NULL;
+    }
+    table->pool = pool;
+    table->capacity = capacity;
+    table->free_head = capacity ? 1 : 0;
+    return 0;
+}
+
+MIDA_API void
+mida_handles_cleanup(struct mida_handles *table)
+{
+    free(table->slots);
+    memset(table, 0, sizeof *table);
+}
+
+MIDA_API mida_handle
+__mida_handle_malloc(struct mida_handles *table,
+                     const size_t container_size,
+                     const size_t element_size,
+                     const size_t count)
+{
+    struct mida_handle_slot *slot;
+    uint32_t index;
+    void *base;
+
+    if (!table->pool)
+        base = __mida_malloc(container_size, element_size, count);
+    else if (element_size && count > (size_t)-1 / element_size)
+        base = NULL;
+    else
+        base = __mida_pool_malloc(table->pool, container_size,
+                                  element_size * count);
+    if (!base) return 0;
+    __mida_spin_lock(&table->lock);
+    if (!table->free_head || table->free_head > table->capacity) {
+        __mida_spin_unlock(&table->lock);
+        __mida_handle_free(table, base, container_size);
+        return 0;
+    }
+    index = table->free_head - 1;
+    slot = &table->slots[index];
+    table->free_head = slot->next_free;
+    __mida_spin_unlock(&table->lock);
+    __atomic_store_n(&slot->base, base, __ATOMIC_RELEASE);
+    return (mida_handle)__atomic_load_n(&slot->generation, __ATOMIC_RELAXED)
+               << 32
+           | index;
+}
+
+MIDA_API void *
+mida_handle_get(const struct mida_handles *table, const mida_handle handle)
+{
+    const uint32_t index = (uint32_t)handle;
+    const struct mida_handle_slot *slot;
+    void *base;
+
+    if (index >= table->capacity) return NULL;
+    slot = &table->slots[index];
+    base = __atomic_load_n(&slot->base, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->generation, __ATOMIC_RELAXED)
+        != (uint32_t)(handle >> 32))
+        return NULL;
+    return base;
+}
+
+MIDA_API void *
+mida_handle_release(struct mida_handles *table, const mida_handle handle)
+{
+    const uint32_t index = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32), next;
+    struct mida_handle_slot *slot;
+    void *base;
+
+    if (index >= table->capacity) return NULL;
+    slot = &table->slots[index];
+    if (!(next = generation + 1)) next = 1;
+    if (!__atomic_compare_exchange_n(&slot->generation, &generation, next, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return NULL;
+    base = __atomic_exchange_n(&slot->base, NULL, __ATOMIC_ACQ_REL);
+    __mida_spin_lock(&table->lock);
+    slot->next_free = table->free_head;
+    table->free_head = index + 1;
+    __mida_spin_unlock(&table->lock);
+    return base;
+}
+
+MIDA_API void
+__mida_handle_free(struct mida_handles *table,
+                   void *base,
+                   const size_t container_size)
+{
+    if (!base) return;
+    if (table->pool)
+        __mida_pool_free(table->pool, container_size, base);
+    else
+        free(__mida_container_from_data(base, container_size));
+}
+
+#endif /* MIDA_WITH_ATOMICS */
+
+static int
+__mida_soa_grow(struct mida_soa *soa)
+{
+    const size_t capacity = soa->capacity ? soa->capacity * 2 : 64;
+    size_t *free_ids, c;
+
+    for (c = 0; c < soa->ncolumns; ++c) {
+        mida_byte *column = realloc(soa->columns[c], capacity * soa->sizes[c]);
+
+        if (!column) return -1;
+        soa->columns[c] = column;
+    }
+    if (!(free_ids = realloc(soa->free_ids, capacity * sizeof *free_ids)))
+        return -1;
+    soa->free_ids = free_ids;
+    soa->capacity = capacity;
+    return 0;
+}
+
+MIDA_API int
+mida_soa_init(struct mida_soa *soa,
+              const size_t sizes[],
+              const size_t ncolumns)
+{
+    memset(soa, 0, sizeof *soa);
+    soa->columns = calloc(ncolumns ? ncolumns : 1, sizeof *soa->columns);
+    soa->sizes = malloc((ncolumns ? ncolumns : 1) * sizeof *soa->sizes);
+    if (!soa->columns || !soa->sizes) {
+        mida_soa_cleanup(soa);
+        return -1;
+    }
+    memcpy(soa->sizes, sizes, ncolumns * sizeof *sizes);
+    soa->ncolumns = ncolumns;
+    return 0;
+}
+
+MIDA_API void
+mida_soa_cleanup(struct mida_soa *soa)
+{
+    size_t c;
+
+    for (c = 0; soa->columns && c < soa->ncolumns; ++c)
+        free(soa->columns[c]);
+    free(soa->columns);
+    free(soa->sizes);
+    free(soa->free_ids);
+    memset(soa, 0, sizeof *soa);
+}
+
+MIDA_API void *
+mida_soa_malloc(struct mida_soa *soa,
+                const size_t element_size,
+                const size_t count)
+{
+    void *base = mida_malloc(struct mida_soa_id, element_size, count);
+    size_t id, c;
+
+    if (!base) return NULL;
+    if (soa->nfree)
+        id = soa->free_ids[--soa->nfree];
+    else if (soa->length < soa->capacity || __mida_soa_grow(soa) == 0)
+        id = soa->length++;
+    else {
+        mida_free(struct mida_soa_id, base);
+        return NULL;
+    }
+    for (c = 0; c < soa->ncolumns; ++c)
+        memset((mida_byte *)soa->columns[c] + id * soa->sizes[c], 0,
+               soa->sizes[c]);
+    MIDA(struct mida_soa_id, base)->id = id;
+    return base;
+}
+
+MIDA_API void
+mida_soa_free(struct mida_soa *soa, void *base)
+{
+    if (!base) return;
+    soa->free_ids[soa->nfree++] = MIDA(struct mida_soa_id, base)->id;
+    mida_free(struct mida_soa_id, base);
+}
+
+#ifdef MIDA_WITH_ATOMICS
+
+static size_t
+__mida_ptr_hash(const void *base)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)base;
+
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    return (size_t)hash;
+}
+
+/* key of the slots of detached buffers, skipped by lookups and reused by
+ * attaches */
+static char __mida_sidetable_tombstone;
+#define __MIDA_TOMBSTONE ((void *)&__mida_sidetable_tombstone)
+
+static struct mida_sidetable_entry
+    __mida_sidetable_entries[MIDA_SIDETABLE_CAPACITY];
+static struct mida_sidetable __mida_sidetable = {
+    __mida_sidetable_entries, MIDA_SIDETABLE_CAPACITY - 1
+};
+
+MIDA_API int
+mida_sidetable_init(struct mida_sidetable *table, const size_t capacity)
+{
+    const size_t size = __mida_pow2(capacity < 2 ? 2 : capacity);
+
+    if (!(table->entries = calloc(size, sizeof *table->entries))) return -1;
+    table->mask = size - 1;
+    return 0;
+}
+
+MIDA_API void
+mida_sidetable_cleanup(struct mida_sidetable *table)
+{
+    free(table->entries);
+    memset(table, 0, sizeof *table);
+}
+
+MIDA_API int
+mida_sidetable_attach(struct mida_sidetable *table,
+                      const void *base,
+                      void *container)
+{
+    const size_t hash = __mida_ptr_hash(base);
+
+    for (;;) {
+        struct mida_sidetable_entry *entry, *free_entry = NULL;
+        void *key = NULL, *expected;
+        size_t i, probes;
+
+        /* the buffer may already be further than the first free slot */
+        for (i = hash, probes = 0; probes <= table->mask; ++probes, ++i) {
+            entry = &table->entries[i & table->mask];
+            key = __atomic_load_n(&entry->base, __ATOMIC_ACQUIRE);
+            if (key == base) {
+                __atomic_store_n(&entry->container, container,
+                                 __ATOMIC_RELEASE);
+                return 0;
+            }
+            if (key == __MIDA_TOMBSTONE && !free_entry) free_entry = entry;
+            if (!key) break;
+        }
+        if (!free_entry) {
+            if (key) return -1;
+            free_entry = entry;
+        }
+        expected = free_entry == entry ? key : __MIDA_TOMBSTONE;
+        if (!__atomic_compare_exchange_n(&free_entry->base, &expected,
+                                         (void *)base, 0, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+            continue; /* taken by another buffer, search again */
+        __atomic_store_n(&free_entry->container, container, __ATOMIC_RELEASE);
+        return 0;
+    }
+}
+
+static struct mida_sidetable_entry *
+__mida_sidetable_find(const struct mida_sidetable *table, const void *base)
+{
+    size_t i = __mida_ptr_hash(base), probes;
+
+    for (probes = 0; probes <= table->mask; ++probes, ++i) {
+        struct mida_sidetable_entry *entry = &table->entries[i & table->mask];
+        const void *key = __atomic_load_n(&entry->base, __ATOMIC_ACQUIRE);
+
+        if (key == base) return entry;
+        if (!key) break;
+    }
+    return NULL;
+}
+
+MIDA_API void *
+mida_sidetable_lookup(const struct mida_sidetable *table, const void *base)
+{
+    struct mida_sidetable_entry *entry = __mida_sidetable_find(table, base);
+    return entry ? __atomic_load_n(&entry->container, __ATOMIC_ACQUIRE)
+                 : NULL;
+}
+
+MIDA_API void *
+mida_sidetable_detach(struct mida_sidetable *table, const void *base)
+{
+    struct mida_sidetable_entry *entry = __mida_sidetable_find(table, base);
+    void *container;
+
+    if (!entry) return NULL;
+    container = __atomic_exchange_n(&entry->container, NULL, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&entry->base, __MIDA_TOMBSTONE, __ATOMIC_RELEASE);
+    return container;
+}
+
+MIDA_API int
+mida_attach(const void *base, void *container)
+{
+    return mida_sidetable_attach(&__mida_sidetable, base, container);
+}
+
+MIDA_API void *
+mida_lookup(const void *base)
+{
+    return mida_sidetable_lookup(&__mida_sidetable, base);
+}
+
+MIDA_API void *
+mida_detach(const void *base)
+{
+    return mida_sidetable_detach(&__mida_sidetable, base);
+}
+
+#undef __MIDA_TOMBSTONE
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#define __mida_layer_align(_size) (((_size) + 15) & ~(size_t)15)
+
+MIDA_API void *
+mida_layered_malloc(const size_t reserve,
+                    const size_t element_size,
+                    const size_t count)
+{
+    const size_t headroom = __mida_layer_align(reserve);
+    mida_byte *block = malloc(headroom + sizeof(struct mida_layers)
+                              + element_size * count);
+    struct mida_layers *layers;
+
+    if (!block) return NULL;
+    layers = (struct mida_layers *)(block + headroom);
+    memset(layers, 0, sizeof *layers);
+    layers->reserve = headroom;
+    return __mida_data_from_container(layers, sizeof *layers);
+}
+
+MIDA_API void
+mida_layered_free(void *base)
+{
+    struct mida_layers *layers;
+
+    if (!base) return;
+    layers = MIDA(struct mida_layers, base);
+    free((mida_byte *)layers - layers->reserve);
+}
+
+MIDA_API int
+__mida_layer_push(void *base, const size_t container_size)
+{
+    struct mida_layers *layers = MIDA(struct mida_layers, base);
+    const size_t used = layers->used + __mida_layer_align(container_size);
+
+    if (layers->count == MIDA_LAYER_MAX || used > layers->reserve) return -1;
+    layers->used = used;
+    layers->offsets[layers->count] = used;
+    memset((mida_byte *)layers - used, 0, container_size);
+    return (int)layers->count++;
+}
+
+MIDA_API void
+mida_layer_pop(void *base)
+{
+    struct mida_layers *layers = MIDA(struct mida_layers, base);
+
+    if (!layers->count) return;
+    layers->used = --layers->count ? layers->offsets[layers->count - 1] : 0;
+}
+
+#undef __mida_layer_align
+
+struct __mida_deep_entry {
+    const void *base;
+    const struct mida_type *type;
+    /** offset in the clone of the pointer to this object */
+    size_t slot;
+};
+
+struct __mida_deep_stack {
+    struct __mida_deep_entry *entries;
+    size_t length;
+    size_t capacity;
+};
+
+static int
+__mida_deep_push(struct __mida_deep_stack *stack,
+                 const void *base,
+                 const struct mida_type *type,
+                 const size_t slot)
+{
+    struct __mida_deep_entry *entry;
+
+    if (stack->length == stack->capacity) {
+        const size_t capacity = stack->capacity ? stack->capacity * 2 : 64;
+        struct __mida_deep_entry *entries =
+            realloc(stack->entries, capacity * sizeof *entries);
+
+        if (!entries) return -1;
+        stack->entries = entries;
+        stack->capacity = capacity;
+    }
+    entry = &stack->entries[stack->length++];
+    entry->base = base;
+    entry->type = type;
+    entry->slot = slot;
+    return 0;
+}
+
+static int
+__mida_deep_push_children(struct __mida_deep_stack *stack,
+                          const struct mida_type *type,
+                          const mida_byte *base,
+                          const size_t count,
+                          const size_t copy)
+{
+    size_t i, f;
+
+    for (i = count; i-- > 0;) {
+        for (f = type->nfields; f-- > 0;) {
+            const size_t offset = i * type->element_size
+                                  + type->fields[f].offset;
+            const void *child = *(void *const *)(base + offset);
+
+            if (child
+                && __mida_deep_push(stack, child, type->fields[f].type,
+                                    copy + offset)
+                       != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+MIDA_API void *
+mida_clone_deep(const struct mida_type *type, const void *base)
+{
+    struct __mida_deep_stack stack = { NULL, 0, 0 };
+    size_t *slots = NULL, nslots = 0, slots_capacity = 0;
+    size_t used = 0, capacity = 0, i;
+    mida_byte *arena = NULL, *shrunk;
+
+    if (!base || __mida_deep_push(&stack, base, type, 0) != 0) return NULL;
+    while (stack.length) {
+        const struct __mida_deep_entry entry = stack.entries[--stack.length];
+        const size_t count = entry.type->count ? entry.type->count(entry.base)
+                                               : 1,
+                     size = entry.type->container_size
+                            + entry.type->element_size * count,
+                     copy = used + entry.type->container_size;
+
+        if (!arena || used + size > capacity) {
+            mida_byte *new_arena;
+
+            capacity = (used + size) * 2 + 16;
+            if (!(new_arena = realloc(arena, capacity))) goto _error;
+            arena = new_arena;
+        }
+        if (nslots == slots_capacity) {
+            size_t *new_slots;
+
+            slots_capacity = slots_capacity ? slots_capacity * 2 : 64;
+            new_slots = realloc(slots, slots_capacity * sizeof *slots);
+            if (!new_slots) goto _error;
+            slots = new_slots;
+        }
+        memcpy(arena + used,
+               __mida_container_from_data(entry.base,
+                                          entry.type->container_size),
+               size);
+        if (used) {
+            memcpy(arena + entry.slot, &copy, sizeof copy);
+            slots[nslots++] = entry.slot;
+        }
+        used = (used + size + 15) & ~(size_t)15;
+        if (__mida_deep_push_children(&stack, entry.type, entry.base, count,
+                                      copy)
+            != 0)
+            goto _error;
+    }
+    free(stack.entries);
+    if (used && (shrunk = realloc(arena, used))) arena = shrunk;
+    for (i = 0; i < nslots; ++i) {
+        size_t copy;
+        void *child;
+
+        memcpy(&copy, arena + slots[i], sizeof copy);
+        child = arena + copy;
+        memcpy(arena + slots[i], &child, sizeof child);
+    }
+    free(slots);
+    return arena + type->container_size;
+_error:
+    free(stack.entries);
+    free(slots);
+    free(arena);
+    return NULL;
+}
+
+/*
+ * Frees one object after handing its children to the work stack. A child
+ * that cannot be pushed, or any child once no stack is given, is freed
+ * recursively right away so that running out of memory never leaks it.
+ */
+static void
+__mida_free_deep_node(struct __mida_deep_stack *stack,
+                      const struct mida_type *type,
+                      void *base)
+{
+    const size_t count = type->count ? type->count(base) : 1;
+    size_t i, f;
+
+    for (i = count; i-- > 0;) {
+        for (f = type->nfields; f-- > 0;) {
+            void *child = *(void **)((mida_byte *)base + i * type->element_size
+                                     + type->fields[f].offset);
+
+            if (child
+                && (!stack
+                    || __mida_deep_push(stack, child, type->fields[f].type, 0)
+                           != 0))
+                __mida_free_deep_node(NULL, type->fields[f].type, child);
+        }
+    }
+    free(__mida_container_from_data(base, type->container_size));
+}
+
+MIDA_API void
+mida_free_deep(const struct mida_type *type, void *base)
+{
+    struct __mida_deep_stack stack = { NULL, 0, 0 };
+
+    if (!base) return;
+    __mida_free_deep_node(&stack, type, base);
+    while (stack.length) {
+        const struct __mida_deep_entry entry = stack.entries[--stack.length];
+
+        __mida_free_deep_node(&stack, entry.type, (void *)entry.base);
+    }
+    free(stack.entries);
+}
+
+struct __mida_near_chunk {
+    /** first chunk of the group */
+    struct __mida_near_chunk *head;
+    /** last chunk of the group, only kept up to date in the head */
+    struct __mida_near_chunk *tail;
+    struct __mida_near_chunk *next;
+    /** live objects of the group, only kept up to date in the head */
+    size_t live;
+    size_t used;
+    size_t size;
+};
+
+#define __MIDA_NEAR_PREFIX 16
+#define __mida_near_align(_size) (((_size) + 15) & ~(size_t)15)
+#define __mida_near_chunk_of(_container)                                      \
+    (*(struct __mida_near_chunk **)((mida_byte *)(_container)                 \
+                                    - __MIDA_NEAR_PREFIX))
+
+MIDA_API void *
+__mida_malloc_near(void *parent_container,
+                   const size_t container_size,
+                   const size_t element_size,
+                   const size_t count)
+{
+    const size_t size = __mida_near_align(__MIDA_NEAR_PREFIX + container_size
+                                          + element_size * count);
+    struct __mida_near_chunk *head = NULL, *chunk = NULL;
+    mida_byte *object;
+
+    if (parent_container) {
+        head = __mida_near_chunk_of(parent_container)->head;
+        chunk = head->tail;
+    }
+    if (!chunk || chunk->used + size > chunk->size) {
+        const size_t header = __mida_near_align(sizeof *chunk),
+                     chunk_size = header + size > MIDA_NEAR_CHUNK
+                                      ? header + size
+                                      : MIDA_NEAR_CHUNK;
+        struct __mida_near_chunk *fresh = malloc(chunk_size);
+
+        if (!fresh) return NULL;
+        fresh->head = head ? head : fresh;
+        fresh->tail = fresh;
+        fresh->next = NULL;
+        fresh->live = 0;
+        fresh->used = header;
+        fresh->size = chunk_size;
+        if (chunk) chunk->next = fresh;
+        if (head) head->tail = fresh;
+        chunk = fresh;
+        head = fresh->head;
+    }
+    object = (mida_byte *)chunk + chunk->used;
+    chunk->used += size;
+    ++head->live;
+    *(struct __mida_near_chunk **)object = chunk;
+    return object + __MIDA_NEAR_PREFIX + container_size;
+}
+
+MIDA_API void
+__mida_free_near(void *container)
+{
+    struct __mida_near_chunk *chunk;
+
+    if (!container) return;
+    chunk = __mida_near_chunk_of(container)->head;
+    if (--chunk->live) return;
+    while (chunk) {
+        struct __mida_near_chunk *next = chunk->next;
+
+        free(chunk);
+        chunk = next;
+    }
+}
+
+#undef __MIDA_NEAR_PREFIX
+#undef __mida_near_align
+#undef __mida_near_chunk_of
+
+#define __mida_walk_link(_walk, _base)                                        \
+    (*(void **)((mida_byte *)(_base) + (_walk)->offset))
+#define __mida_walk_discover(_walk, _base)                                    \
+    do {                                                                      \
+        (_walk)->window[((_walk)->head + (_walk)->count++) % MIDA_WALK_MAX] = \
+            (_base);                                                          \
+        mida_prefetch_range((mida_byte *)(_base) - (_walk)->container_size,   \
+                            (_walk)->container_size + MIDA_PREFETCH_DATA);    \
+    } while (0)
+
+MIDA_API void
+__mida_walk_init(struct mida_walk *walk,
+                 void *first,
+                 const size_t container_size,
+                 const size_t offset,
+                 const size_t depth)
+{
+    walk->head = 0;
+    walk->count = 0;
+    walk->depth = !depth ? 1 : depth > MIDA_WALK_MAX ? MIDA_WALK_MAX : depth;
+    walk->offset = offset;
+    walk->container_size = container_size;
+    while (first && walk->count < walk->depth) {
+        __mida_walk_discover(walk, first);
+        first = __mida_walk_link(walk, first);
+    }
+}
+
+MIDA_API void *
+mida_walk_next(struct mida_walk *walk)
+{
+    void *node, *last;
+
+    if (!walk->count) return NULL;
+    node = walk->window[walk->head];
+    last = walk->window[(walk->head + walk->count - 1) % MIDA_WALK_MAX];
+    walk->head = (walk->head + 1) % MIDA_WALK_MAX;
+    --walk->count;
+    /* the last node was prefetched when discovered, read its link now */
+    if ((last = __mida_walk_link(walk, last)) != NULL)
+        __mida_walk_discover(walk, last);
+    return node;
+}
+
+#undef __mida_walk_link
+#undef __mida_walk_discover
+
+#define __MIDA_COMPACT_MAX ((sizeof(size_t) * 8 + 6) / 7)
+#define __MIDA_COMPACT_MASK ((1u << MIDA_COMPACT_FLAG_BITS) - 1)
+
+static size_t
+__mida_compact_decode(const void *base, size_t *header_size)
+{
+    const unsigned char *p = base;
+    size_t value = 0, n = 0;
+    unsigned char byte;
+
+    do {
+        byte = *--p;
+        value |= (size_t)(byte & 0x7f) << (7 * n++);
+    } while (byte & 0x80);
+    if (header_size) *header_size = n;
+    return value;
+}
+
+static void *
+__mida_compact_malloc(const size_t length,
+                      const unsigned flags,
+                      const size_t extra)
+{
+    unsigned char header[__MIDA_COMPACT_MAX], *data;
+    size_t value = (length << MIDA_COMPACT_FLAG_BITS)
+                   | (flags & __MIDA_COMPACT_MASK),
+           n = 0;
+
+    if (length > ((size_t)-1 >> MIDA_COMPACT_FLAG_BITS)) return NULL;
+    do {
+        header[n] = value & 0x7f;
+        if (value >>= 7) header[n] |= 0x80;
+        ++n;
+    } while (value);
+    if (!(data = malloc(n + length + extra))) return NULL;
+    data += n;
+    while (n--)
+        data[-1 - (ptrdiff_t)n] = header[n];
+    return data;
+}
+
+MIDA_API void *
+mida_compact_malloc(const size_t length, const unsigned flags)
+{
+    return __mida_compact_malloc(length, flags, 0);
+}
+
+MIDA_API char *
+mida_compact_string(const char *string, const size_t length)
+{
+    char *copy = __mida_compact_malloc(length, 0, 1);
+
+    if (!copy) return NULL;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+MIDA_API size_t
+mida_compact_length(const void *base)
+{
+    return __mida_compact_decode(base, NULL) >> MIDA_COMPACT_FLAG_BITS;
+}
+
+MIDA_API unsigned
+mida_compact_flags(const void *base)
+{
+    return ((const unsigned char *)base)[-1] & __MIDA_COMPACT_MASK;
+}
+
+MIDA_API void
+mida_compact_set_flags(void *base, const unsigned flags)
+{
+    unsigned char *p = (unsigned char *)base - 1;
+    *p = (unsigned char)((*p & ~__MIDA_COMPACT_MASK)
+                         | (flags & __MIDA_COMPACT_MASK));
+}
+
+MIDA_API void
+mida_compact_free(void *base)
+{
+    size_t n;
+
+    if (!base) return;
+    __mida_compact_decode(base, &n);
+    free((unsigned char *)base - n);
+}
+
+#undef __MIDA_COMPACT_MAX
+#undef __MIDA_COMPACT_MASK
+
+#define __MIDA_STR_MIN 15
+
+MIDA_API char *
+mida_str_new(const char *string)
+{
+    char *str = NULL;
+
+    if (mida_str_append(&str, string ? string : "")) return NULL;
+    return str;
+}
+
+MIDA_API int
+mida_str_reserve(char **p_string, const size_t extra)
+{
+    struct mida_str *str = *p_string ? MIDA(struct mida_str, *p_string)
+                                     : NULL;
+    size_t length = str ? str->length : 0, capacity = str ? str->capacity : 0;
+    char *string;
+
+    if (*p_string && extra <= capacity - length) return 0;
+    if (extra > (size_t)-1 / 2 - sizeof *str - length) return -1;
+    capacity = capacity * 2 > length + extra ? capacity * 2 : length + extra;
+    if (capacity < __MIDA_STR_MIN) capacity = __MIDA_STR_MIN;
+    string = mida_realloc(struct mida_str, *p_string, 1, capacity + 1);
+    if (!string) return -1;
+    str = MIDA(struct mida_str, string);
+    str->length = length;
+    str->capacity = capacity;
+    string[length] = '\0';
+    *p_string = string;
+    return 0;
+}
+
+MIDA_API int
+mida_str_appendn(char **p_string, const char *src, size_t n)
+{
+    const char *old = *p_string;
+    struct mida_str *str;
+    size_t offset = 0;
+    int inside = 0;
+
+    /* src may point into the string itself, which reserving can move */
+    if (old && src >= old
+        && src <= old + MIDA(struct mida_str, old)->length) {
+        offset = (size_t)(src - old);
+        inside = 1;
+    }
+    if (mida_str_reserve(p_string, n)) return -1;
+    str = MIDA(struct mida_str, *p_string);
+    if (inside) src = *p_string + offset;
+    memcpy(*p_string + str->length, src, n);
+    str->length += n;
+    (*p_string)[str->length] = '\0';
+    return 0;
+}
+
+MIDA_API int
+mida_str_append(char **p_string, const char *src)
+{
+    return mida_str_appendn(p_string, src, strlen(src));
+}
+
+#ifdef MIDA_WITH_C99
+
+MIDA_API int
+mida_str_appendf(char **p_string, const char *format, ...)
+{
+    char scratch[256], *formatted = scratch;
+    va_list args;
+    int n, result;
+
+    /* the arguments may point into the string, so it is formatted aside
+     * and only then appended; short output needs a single pass */
+    va_start(args, format);
+    n = vsnprintf(scratch, sizeof scratch, format, args);
+    va_end(args);
+    if (n < 0) return -1;
+    if ((size_t)n >= sizeof scratch) {
+        if (!(formatted = malloc((size_t)n + 1))) return -1;
+        va_start(args, format);
+        vsnprintf(formatted, (size_t)n + 1, format, args);
+        va_end(args);
+    }
+    result = mida_str_appendn(p_string, formatted, (size_t)n);
+    if (formatted != scratch) free(formatted);
+    return result;
+}
+
+#endif /* MIDA_WITH_C99 */
+
+MIDA_API void
+mida_str_clear(char *string)
+{
+    MIDA(struct mida_str, string)->length = 0;
+    *string = '\0';
+}
+
+MIDA_API void
+mida_str_free(char *string)
+{
+    if (string) mida_free(struct mida_str, string);
+}
+
+#undef __MIDA_STR_MIN
+
+#define __MIDA_XXH_P1 UINT64_C(0x9E3779B185EBCA87)
+#define __MIDA_XXH_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define __MIDA_XXH_P3 UINT64_C(0x165667B19E3779F9)
+#define __MIDA_XXH_P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define __MIDA_XXH_P5 UINT64_C(0x27D4EB2F165667C5)
+#define __mida_rotl64(_x, _r) (((_x) << (_r)) | ((_x) >> (64 - (_r))))
+
+static uint64_t
+__mida_xxh_read64(const unsigned char *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof value);
+    return value;
+}
+
+static uint64_t
+__mida_xxh_round(uint64_t acc, const uint64_t input)
+{
+    acc += input * __MIDA_XXH_P2;
+    acc = __mida_rotl64(acc, 31);
+    return acc * __MIDA_XXH_P1;
+}
+
+static uint64_t
+__mida_xxh_merge(uint64_t acc, const uint64_t value)
+{
+    acc ^= __mida_xxh_round(0, value);
+    return acc * __MIDA_XXH_P1 + __MIDA_XXH_P4;
+}
+
+MIDA_API uint64_t
+mida_hash(const void *data, const size_t length)
+{
+    const unsigned char *p = data, *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = __MIDA_XXH_P1 + __MIDA_XXH_P2, v2 = __MIDA_XXH_P2,
+                 v3 = 0, v4 = 0 - __MIDA_XXH_P1;
+
+        do {
+            v1 = __mida_xxh_round(v1, __mida_xxh_read64(p));
+            v2 = __mida_xxh_round(v2, __mida_xxh_read64(p + 8));
+            v3 = __mida_xxh_round(v3, __mida_xxh_read64(p + 16));
+            v4 = __mida_xxh_round(v4, __mida_xxh_read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        hash = __mida_rotl64(v1, 1) + __mida_rotl64(v2, 7)
+               + __mida_rotl64(v3, 12) + __mida_rotl64(v4, 18);
+        hash = __mida_xxh_merge(hash, v1);
+        hash = __mida_xxh_merge(hash, v2);
+        hash = __mida_xxh_merge(hash, v3);
+        hash = __mida_xxh_merge(hash, v4);
+    }
+    else {
+        hash = __MIDA_XXH_P5;
+    }
+    hash += (uint64_t)length;
+    for (; end - p >= 8; p += 8) {
+        hash ^= __mida_xxh_round(0, __mida_xxh_read64(p));
+        hash = __mida_rotl64(hash, 27) * __MIDA_XXH_P1 + __MIDA_XXH_P4;
+    }
+    if (end - p >= 4) {
+        uint32_t word;
+
+        memcpy(&word, p, sizeof word);
+        hash ^= (uint64_t)word * __MIDA_XXH_P1;
+        hash = __mida_rotl64(hash, 23) * __MIDA_XXH_P2 + __MIDA_XXH_P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * __MIDA_XXH_P5;
+        hash = __mida_rotl64(hash, 11) * __MIDA_XXH_P1;
+    }
+    hash ^= hash >> 33;
+    hash *= __MIDA_XXH_P2;
+    hash ^= hash >> 29;
+    hash *= __MIDA_XXH_P3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#undef __MIDA_XXH_P1
+#undef __MIDA_XXH_P2
+#undef __MIDA_XXH_P3
+#undef __MIDA_XXH_P4
+#undef __MIDA_XXH_P5
+#undef __mida_rotl64
+
+static char *
+__mida_hstr_new(const char *string, const size_t length, const uint64_t hash)
+{
+    char *copy = mida_malloc(struct mida_hstr, 1, length + 1);
+
+    if (!copy) return NULL;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    MIDA(struct mida_hstr, copy)->hash = hash;
+    MIDA(struct mida_hstr, copy)->length = length;
+    return copy;
+}
+
+MIDA_API char *
+mida_hstr_new(const char *string, const size_t length)
+{
+    return __mida_hstr_new(string, length, mida_hash(string, length));
+}
+
+MIDA_API int
+mida_hstr_equals(const char *a, const char *b)
+{
+    const struct mida_hstr *ha = MIDA(const struct mida_hstr, a),
+                           *hb = MIDA(const struct mida_hstr, b);
+
+    return a == b
+           || (ha->hash == hb->hash && ha->length == hb->length
+               && 0 == memcmp(a, b, ha->length));
+}
+
+MIDA_API void
+mida_hstr_free(char *string)
+{
+    if (string) mida_free(struct mida_hstr, string);
+}
+
+#ifdef MIDA_WITH_ATOMICS
+
+#define __MIDA_INTERN_MIN 16
+
+MIDA_API void
+mida_interns_init(struct mida_interns *pool)
+{
+    memset(pool, 0, sizeof *pool);
+}
+
+MIDA_API void
+mida_interns_cleanup(struct mida_interns *pool)
+{
+    size_t i, j;
+
+    for (i = 0; i < MIDA_INTERN_SHARDS; ++i) {
+        struct mida_intern_shard *shard = &pool->shards[i];
+
+        for (j = 0; j < shard->capacity; ++j)
+            mida_hstr_free(shard->slots[j]);
+        free(shard->slots);
+    }
+    memset(pool, 0, sizeof *pool);
+}
+
+static int
+__mida_intern_grow(struct mida_intern_shard *shard)
+{
+    const size_t capacity =
+        shard->capacity ? shard->capacity * 2 : __MIDA_INTERN_MIN;
+    char **slots = calloc(capacity, sizeof *slots);
+    size_t i;
+
+    if (!slots) return -1;
+    for (i = 0; i < shard->capacity; ++i) {
+        char *string = shard->slots[i];
+        size_t at;
+
+        if (!string) continue;
+        at = (size_t)MIDA(struct mida_hstr, string)->hash & (capacity - 1);
+        while (slots[at])
+            at = (at + 1) & (capacity - 1);
+        slots[at] = string;
+    }
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+    return 0;
+}
+
+MIDA_API const char *
+mida_intern(struct mida_interns *pool,
+            const char *string,
+            const size_t length)
+{
+    const uint64_t hash = mida_hash(string, length);
+    /* the low bits pick the slot, take the shard from the high ones */
+    struct mida_intern_shard *shard =
+        &pool->shards[(size_t)(hash >> 40) % MIDA_INTERN_SHARDS];
+    char *found = NULL;
+    size_t at;
+
+    __mida_spin_lock(&shard->lock);
+    if ((shard->count + 1) * 2 > shard->capacity && __mida_intern_grow(shard))
+    {
+        __mida_spin_unlock(&shard->lock);
+        return NULL;
+    }
+    at = (size_t)hash & (shard->capacity - 1);
+    while ((found = shard->slots[at]) != NULL) {
+        const struct mida_hstr *h = MIDA(struct mida_hstr, found);
+
+        if (h->hash == hash && h->length == length
+            && 0 == memcmp(found, string, length))
+            break;
+        at = (at + 1) & (shard->capacity - 1);
+    }
+    if (!found && (found = __mida_hstr_new(string, length, hash)) != NULL) {
+        shard->slots[at] = found;
+        ++shard->count;
+    }
+    __mida_spin_unlock(&shard->lock);
+    return found;
+}
+
+#undef __MIDA_INTERN_MIN
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#define __mida_str_length(_string) MIDA(const struct mida_str, _string)->length
+
+static size_t
+__mida_mismatch_scalar(const unsigned char *a,
+                       const unsigned char *b,
+                       const size_t n)
+{
+    size_t i = 0;
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+static size_t
+__mida_find_scalar(const unsigned char *s,
+                   const size_t n,
+                   const unsigned char *needle,
+                   const size_t m)
+{
+    size_t i;
+    for (i = 0; i + m <= n; ++i)
+        if (s[i] == needle[0] && 0 == memcmp(s + i, needle, m)) return i;
+    return n;
+}
+
+static size_t
+__mida_find_any_scalar(const unsigned char *s,
+                       const size_t n,
+                       const unsigned char *set,
+                       const size_t k)
+{
+    unsigned char table[256] = { 0 };
+    size_t i;
+
+    for (i = 0; i < k; ++i)
+        table[set[i]] = 1;
+    for (i = 0; i < n && !table[s[i]]; ++i)
+        continue;
+    return i;
+}
+
+static void
+__mida_to_lower_scalar(unsigned char *s, const size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; ++i)
+        if (s[i] >= 'A' && s[i] <= 'Z') s[i] += 'a' - 'A';
+}
+
+/* records the slices between separators from `i` on, or only counts them
+ * if `slices` is NULL, and returns the total count */
+static size_t
+__mida_split_scalar(const char *string,
+                    size_t i,
+                    const size_t n,
+                    const char separator,
+                    struct mida_slice *slices,
+                    size_t count,
+                    size_t start)
+{
+    for (; i <= n; ++i) {
+        if (i < n && string[i] != separator) continue;
+        if (slices) {
+            slices[count].data = string + start;
+            slices[count].length = i - start;
+        }
+        ++count;
+        start = i + 1;
+    }
+    return count;
+}
+
+#ifdef MIDA_WITH_SSE2
+
+#include <immintrin.h>
+
+/* the longest set searched with vector compares, longer ones use a table */
+#define __MIDA_FIND_ANY_SIMD 16
+
+/* checks a candidate whose first and last bytes match, without calling
+ * memcmp() so that the vector registers are not spilled around the call */
+static int
+__mida_find_middle(const unsigned char *s,
+                   const unsigned char *needle,
+                   const size_t m)
+{
+    size_t j;
+    for (j = 1; j + 1 < m && s[j] == needle[j]; ++j)
+        continue;
+    return j + 1 >= m;
+}
+
+#define __mida_eq128(_a, _b, _i)                                              \
+    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)((_a) + (_i))),           \
+                   _mm_loadu_si128((const __m128i *)((_b) + (_i))))
+#define __mida_eq256(_a, _b, _i)                                              \
+    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)((_a) + (_i))),     \
+                      _mm256_loadu_si256((const __m256i *)((_b) + (_i))))
+
+static size_t
+__mida_mismatch_sse2(const unsigned char *a,
+                     const unsigned char *b,
+                     const size_t n)
+{
+    size_t i;
+
+    /* skip equal blocks 4 vectors at a time, then pinpoint the mismatch */
+    for (i = 0; i + 64 <= n; i += 64) {
+        const __m128i c0 = __mida_eq128(a, b, i),
+                      c1 = __mida_eq128(a, b, i + 16),
+                      c2 = __mida_eq128(a, b, i + 32),
+                      c3 = __mida_eq128(a, b, i + 48);
+        if (0xffff != _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(c0, c1),
+                                                      _mm_and_si128(c2, c3))))
+            break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)(a + i)),
+                      vb = _mm_loadu_si128((const __m128i *)(b + i));
+        const unsigned mask =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffffu;
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + __mida_mismatch_scalar(a + i, b + i, n - i);
+}
+
+/* compares the first and last byte of the needle at 16 positions at once,
+ * and only checks the middle of the candidates */
+static size_t
+__mida_find_sse2(const unsigned char *s,
+                 const size_t n,
+                 const unsigned char *needle,
+                 const size_t m)
+{
+    const __m128i first = _mm_set1_epi8((char)needle[0]),
+                  last = _mm_set1_epi8((char)needle[m - 1]);
+    size_t i;
+
+    for (i = 0; i + m - 1 + 16 <= n; i += 16) {
+        const __m128i vf = _mm_loadu_si128((const __m128i *)(s + i)),
+                      vl = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(vf, first), _mm_cmpeq_epi8(vl, last)));
+
+        for (; mask; mask &= mask - 1) {
+            const size_t at = i + (size_t)__builtin_ctz(mask);
+            if (__mida_find_middle(s + at, needle, m)) return at;
+        }
+    }
+    return i + __mida_find_scalar(s + i, n - i, needle, m);
+}
+
+static size_t
+__mida_find_any_sse2(const unsigned char *s,
+                     const size_t n,
+                     const unsigned char *set,
+                     const size_t k)
+{
+    __m128i sets[__MIDA_FIND_ANY_SIMD];
+    size_t i, j;
+
+    for (j = 0; j < k; ++j)
+        sets[j] = _mm_set1_epi8((char)set[j]);
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hits = _mm_cmpeq_epi8(v, sets[0]);
+        unsigned mask;
+
+        for (j = 1; j < k; ++j)
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, sets[j]));
+        if ((mask = (unsigned)_mm_movemask_epi8(hits)) != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + __mida_find_any_scalar(s + i, n - i, set, k);
+}
+
+static void
+__mida_to_lower_sse2(unsigned char *s, const size_t n)
+{
+    const __m128i before_a = _mm_set1_epi8('A' - 1),
+                  after_z = _mm_set1_epi8('Z' + 1),
+                  shift = _mm_set1_epi8('a' - 'A');
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, before_a),
+                                            _mm_cmplt_epi8(v, after_z));
+        _mm_storeu_si128((__m128i *)(s + i),
+                         _mm_add_epi8(v, _mm_and_si128(upper, shift)));
+    }
+    __mida_to_lower_scalar(s + i, n - i);
+}
+
+static size_t
+__mida_split_sse2(const char *string,
+                  const size_t n,
+                  const char separator,
+                  struct mida_slice *slices)
+{
+    const __m128i sep = _mm_set1_epi8(separator);
+    size_t i, count = 0, start = 0;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(string + i)), sep));
+
+        if (!slices) {
+            count += (size_t)__builtin_popcount(mask);
+            continue;
+        }
+        for (; mask; mask &= mask - 1) {
+            const size_t at = i + (size_t)__builtin_ctz(mask);
+            slices[count].data = string + start;
+            slices[count++].length = at - start;
+            start = at + 1;
+        }
+    }
+    return __mida_split_scalar(string, i, n, separator, slices, count, start);
+}
+
+#define __MIDA_AVX2 __attribute__((target("avx2")))
+
+static int __mida_avx2 = -1;
+
+static int
+__mida_has_avx2(void)
+{
+    if (__mida_avx2 < 0) __mida_avx2 = __builtin_cpu_supports("avx2") != 0;
+    return __mida_avx2;
+}
+
+__MIDA_AVX2 static size_t
+__mida_mismatch_avx2(const unsigned char *a,
+                     const unsigned char *b,
+                     const size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 128 <= n; i += 128) {
+        const __m256i c0 = __mida_eq256(a, b, i),
+                      c1 = __mida_eq256(a, b, i + 32),
+                      c2 = __mida_eq256(a, b, i + 64),
+                      c3 = __mida_eq256(a, b, i + 96);
+        if (-1 != _mm256_movemask_epi8(_mm256_and_si256(
+                      _mm256_and_si256(c0, c1), _mm256_and_si256(c2, c3))))
+            break;
+    }
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i)),
+                      vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        const unsigned mask =
+            ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + __mida_mismatch_sse2(a + i, b + i, n - i);
+}
+
+__MIDA_AVX2 static size_t
+__mida_find_avx2(const unsigned char *s,
+                 const size_t n,
+                 const unsigned char *needle,
+                 const size_t m)
+{
+    const __m256i first = _mm256_set1_epi8((char)needle[0]),
+                  last = _mm256_set1_epi8((char)needle[m - 1]);
+    size_t i;
+
+    for (i = 0; i + m - 1 + 32 <= n; i += 32) {
+        const __m256i vf = _mm256_loadu_si256((const __m256i *)(s + i)),
+                      vl =
+                          _mm256_loadu_si256((const __m256i *)(s + i + m - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(vf, first), _mm256_cmpeq_epi8(vl, last)));
+
+        for (; mask; mask &= mask - 1) {
+            const size_t at = i + (size_t)__builtin_ctz(mask);
+            if (__mida_find_middle(s + at, needle, m)) return at;
+        }
+    }
+    return i + __mida_find_sse2(s + i, n - i, needle, m);
+}
+
+__MIDA_AVX2 static size_t
+__mida_find_any_avx2(const unsigned char *s,
+                     const size_t n,
+                     const unsigned char *set,
+                     const size_t k)
+{
+    __m256i sets[__MIDA_FIND_ANY_SIMD];
+    size_t i, j;
+
+    for (j = 0; j < k; ++j)
+        sets[j] = _mm256_set1_epi8((char)set[j]);
+    for (i = 0; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hits = _mm256_cmpeq_epi8(v, sets[0]);
+        unsigned mask;
+
+        for (j = 1; j < k; ++j)
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(v, sets[j]));
+        if ((mask = (unsigned)_mm256_movemask_epi8(hits)) != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + __mida_find_any_sse2(s + i, n - i, set, k);
+}
+
+__MIDA_AVX2 static void
+__mida_to_lower_avx2(unsigned char *s, const size_t n)
+{
+    const __m256i before_a = _mm256_set1_epi8('A' - 1),
+                  after_z = _mm256_set1_epi8('Z' + 1),
+                  shift = _mm256_set1_epi8('a' - 'A');
+    size_t i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        const __m256i upper = _mm256_and_si256(
+            _mm256_cmpgt_epi8(v, before_a), _mm256_cmpgt_epi8(after_z, v));
+        _mm256_storeu_si256(
+            (__m256i *)(s + i),
+            _mm256_add_epi8(v, _mm256_and_si256(upper, shift)));
+    }
+    __mida_to_lower_sse2(s + i, n - i);
+}
+
+__MIDA_AVX2 static size_t
+__mida_split_avx2(const char *string,
+                  const size_t n,
+                  const char separator,
+                  struct mida_slice *slices)
+{
+    const __m256i sep = _mm256_set1_epi8(separator);
+    size_t i, count = 0, start = 0;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)(string + i)), sep));
+
+        if (!slices) {
+            count += (size_t)__builtin_popcount(mask);
+            continue;
+        }
+        for (; mask; mask &= mask - 1) {
+            const size_t at = i + (size_t)__builtin_ctz(mask);
+            slices[count].data = string + start;
+            slices[count++].length = at - start;
+            start = at + 1;
+        }
+    }
+    return __mida_split_scalar(string, i, n, separator, slices, count, start);
+}
+
+#undef __MIDA_AVX2
+
+static size_t
+__mida_mismatch(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    return __mida_has_avx2() ? __mida_mismatch_avx2(a, b, n)
+                             : __mida_mismatch_sse2(a, b, n);
+}
+
+static size_t
+__mida_find(const unsigned char *s,
+            const size_t n,
+            const unsigned char *needle,
+            const size_t m)
+{
+    return __mida_has_avx2() ? __mida_find_avx2(s, n, needle, m)
+                             : __mida_find_sse2(s, n, needle, m);
+}
+
+static size_t
+__mida_find_any(const unsigned char *s,
+                const size_t n,
+                const unsigned char *set,
+                const size_t k)
+{
+    if (!k || k > __MIDA_FIND_ANY_SIMD)
+        return __mida_find_any_scalar(s, n, set, k);
+    return __mida_has_avx2() ? __mida_find_any_avx2(s, n, set, k)
+                             : __mida_find_any_sse2(s, n, set, k);
+}
+
+static void
+__mida_to_lower(unsigned char *s, const size_t n)
+{
+    if (__mida_has_avx2())
+        __mida_to_lower_avx2(s, n);
+    else
+        __mida_to_lower_sse2(s, n);
+}
+
+static size_t
+__mida_split(const char *string,
+             const size_t n,
+             const char separator,
+             struct mida_slice *slices)
+{
+    return __mida_has_avx2() ? __mida_split_avx2(string, n, separator, slices)
+                             : __mida_split_sse2(string, n, separator, slices);
+}
+
+#undef __MIDA_FIND_ANY_SIMD
+#undef __mida_eq128
+#undef __mida_eq256
+
+#else
+
+#define __mida_mismatch __mida_mismatch_scalar
+#define __mida_find __mida_find_scalar
+#define __mida_find_any __mida_find_any_scalar
+#define __mida_to_lower __mida_to_lower_scalar
+#define __mida_split(_string, _n, _separator, _slices)                        \
+    __mida_split_scalar(_string, 0, _n, _separator, _slices, 0, 0)
+
+#endif /* MIDA_WITH_SSE2 */
+
+MIDA_API int
+mida_str_equals(const char *a, const char *b)
+{
+    const size_t n = __mida_str_length(a);
+
+    return n == __mida_str_length(b)
+           && n == __mida_mismatch((const unsigned char *)a,
+                                   (const unsigned char *)b, n);
+}
+
+MIDA_API int
+mida_str_compare(const char *a, const char *b)
+{
+    const size_t na = __mida_str_length(a), nb = __mida_str_length(b),
+                 n = na < nb ? na : nb,
+                 at = __mida_mismatch((const unsigned char *)a,
+                                      (const unsigned char *)b, n);
+
+    if (at < n) return (int)(unsigned char)a[at] - (int)(unsigned char)b[at];
+    return na < nb ? -1 : na > nb;
+}
+
+MIDA_API char *
+mida_str_find(const char *string, const char *needle, const size_t length)
+{
+    const size_t n = __mida_str_length(string);
+    size_t at;
+
+    if (!length) return (char *)string;
+    if (length > n) return NULL;
+    at = __mida_find((const unsigned char *)string, n,
+                     (const unsigned char *)needle, length);
+    return at < n ? (char *)string + at : NULL;
+}
+
+MIDA_API char *
+mida_str_find_any(const char *string, const char *set)
+{
+    const size_t n = __mida_str_length(string),
+                 at = __mida_find_any((const unsigned char *)string, n,
+                                      (const unsigned char *)set,
+                                      strlen(set));
+
+    return at < n ? (char *)string + at : NULL;
+}
+
+MIDA_API void
+mida_str_to_lower(char *string)
+{
+    __mida_to_lower((unsigned char *)string, __mida_str_length(string));
+}
+
+MIDA_API struct mida_slice *
+mida_str_split(const char *string, const char separator)
+{
+    const size_t n = __mida_str_length(string),
+                 count = __mida_split(string, n, separator, NULL);
+    struct mida_slice *slices =
+        mida_malloc(struct mida_str, sizeof *slices, count);
+
+    if (!slices) return NULL;
+    MIDA(struct mida_str, slices)->length = count;
+    MIDA(struct mida_str, slices)->capacity = count;
+    __mida_split(string, n, separator, slices);
+    return slices;
+}
+
+#undef __mida_str_length
+#undef __mida_mismatch
+#undef __mida_find
+#undef __mida_find_any
+#undef __mida_to_lower
+#undef __mida_split
+
+#define __MIDA_MAP_MIN 16
+#define __mida_map_node(_map, _base)                                          \
+    ((struct mida_hnode *)((mida_byte *)(_base) - (_map)->distance))
+#define __mida_map_base(_map, _node) ((mida_byte *)(_node) + (_map)->distance)
+
+MIDA_API void
+__mida_map_init(struct mida_map *map,
+                const size_t distance,
+                int (*eq)(const void *base, const void *key))
+{
+    map->buckets = NULL;
+    map->mask = 0;
+    map->count = 0;
+    map->distance = distance;
+    map->eq = eq;
+}
+
+MIDA_API void
+mida_map_cleanup(struct mida_map *map)
+{
+    free(map->buckets);
+    map->buckets = NULL;
+    map->mask = 0;
+    map->count = 0;
+}
+
+static int
+__mida_map_grow(struct mida_map *map)
+{
+    const size_t capacity = map->buckets ? (map->mask + 1) * 2
+                                         : __MIDA_MAP_MIN;
+    struct mida_hnode **buckets = calloc(capacity, sizeof *buckets);
+    size_t i;
+
+    if (!buckets) return -1;
+    for (i = 0; map->buckets && i <= map->mask; ++i) {
+        struct mida_hnode *node = map->buckets[i], *next;
+
+        for (; node; node = next) {
+            struct mida_hnode **bucket =
+                &buckets[(size_t)node->hash & (capacity - 1)];
+
+            next = node->next;
+            node->next = *bucket;
+            *bucket = node;
+        }
+    }
+    free(map->buckets);
+    map->buckets = buckets;
+    map->mask = capacity - 1;
+    return 0;
+}
+
+MIDA_API int
+mida_map_insert(struct mida_map *map, void *base, const uint64_t hash)
+{
+    struct mida_hnode *node = __mida_map_node(map, base), **bucket;
+
+    if ((!map->buckets || map->count > map->mask) && __mida_map_grow(map))
+        return -1;
+    bucket = &map->buckets[(size_t)hash & map->mask];
+    node->hash = hash;
+    node->next = *bucket;
+    *bucket = node;
+    ++map->count;
+    return 0;
+}
+
+static struct mida_hnode **
+__mida_map_lookup(const struct mida_map *map,
+                  const uint64_t hash,
+                  const void *key)
+{
+    struct mida_hnode **link;
+
+    if (!map->buckets) return NULL;
+    for (link = &map->buckets[(size_t)hash & map->mask]; *link;
+         link = &(*link)->next)
+    {
+        if ((*link)->hash == hash
+            && (!map->eq || map->eq(__mida_map_base(map, *link), key)))
+            return link;
+    }
+    return NULL;
+}
+
+MIDA_API void *
+mida_map_find(const struct mida_map *map, const uint64_t hash, const void *key)
+{
+    const struct mida_hnode *node;
+
+    if (!map->buckets) return NULL;
+    for (node = map->buckets[(size_t)hash & map->mask]; node;
+         node = node->next)
+    {
+        if (node->hash == hash
+            && (!map->eq || map->eq(__mida_map_base(map, node), key)))
+            return __mida_map_base(map, node);
+    }
+    return NULL;
+}
+
+MIDA_API void *
+mida_map_remove(struct mida_map *map, const uint64_t hash, const void *key)
+{
+    struct mida_hnode **link = __mida_map_lookup(map, hash, key), *node;
+
+    if (!link) return NULL;
+    node = *link;
+    *link = node->next;
+    --map->count;
+    return __mida_map_base(map, node);
+}
+
+MIDA_API void
+mida_map_unlink(struct mida_map *map, void *base)
+{
+    struct mida_hnode *node = __mida_map_node(map, base), **link;
+
+    if (!map->buckets) return;
+    for (link = &map->buckets[(size_t)node->hash & map->mask]; *link;
+         link = &(*link)->next)
+    {
+        if (*link == node) {
+            *link = node->next;
+            --map->count;
+            return;
+        }
+    }
+}
+
+MIDA_API void *
+mida_map_next(const struct mida_map *map, const void *base)
+{
+    size_t i = 0;
+
+    if (!map->buckets) return NULL;
+    if (base) {
+        const struct mida_hnode *node =
+            __mida_map_node(map, (mida_byte *)base);
+
+        if (node->next) return __mida_map_base(map, node->next);
+        i = ((size_t)node->hash & map->mask) + 1;
+    }
+    for (; i <= map->mask; ++i)
+        if (map->buckets[i]) return __mida_map_base(map, map->buckets[i]);
+    return NULL;
+}
+
+#undef __MIDA_MAP_MIN
+#undef __mida_map_node
+#undef __mida_map_base
+
+#ifdef MIDA_WITH_ATOMICS
+
+#define __mida_lru_node(_lru, _base)                                          \
+    ((struct mida_lru_node *)((mida_byte *)(_base) - (_lru)->distance))
+#define __mida_lru_base(_lru, _node) ((mida_byte *)(_node) + (_lru)->distance)
+#define __mida_lru_shard(_lru, _hash)                                         \
+    (&(_lru)->shards[(size_t)((_hash) >> 40) % MIDA_LRU_SHARDS])
+
+/* states of a mida_lru_node, only changed under the lock of the shard of
+ * its hash, and read unlocked by mida_lru_put() for objects of another one */
+#define __MIDA_LRU_FREE 0
+#define __MIDA_LRU_CACHED 1
+#define __MIDA_LRU_EVICTED 2
+
+MIDA_API void
+__mida_lru_init(struct mida_lru *lru,
+                const size_t distance,
+                const size_t budget,
+                int (*eq)(const void *base, const void *key),
+                void (*evict)(void *base, void *context),
+                void *context)
+{
+    size_t i;
+
+    memset(lru, 0, sizeof *lru);
+    for (i = 0; i < MIDA_LRU_SHARDS; ++i) {
+        struct mida_lru_shard *shard = &lru->shards[i];
+
+        /* the map links through the mida_hnode at the start of the node */
+        __mida_map_init(&shard->map, distance, eq);
+        shard->list.prev = shard->list.next = &shard->list;
+        shard->budget = budget / MIDA_LRU_SHARDS;
+    }
+    lru->distance = distance;
+    lru->evict = evict;
+    lru->context = context;
+}
+
+static void
+__mida_lru_unlink(struct mida_lru_node *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+static void
+__mida_lru_push_front(struct mida_lru_shard *shard,
+                      struct mida_lru_node *node)
+{
+    node->prev = &shard->list;
+    node->next = shard->list.next;
+    shard->list.next->prev = node;
+    shard->list.next = node;
+}
+
+/* takes a node out of the shard; unless referenced, it is queued on `dead`
+ * to be released once the lock is dropped */
+static void
+__mida_lru_evict(struct mida_lru *lru,
+                 struct mida_lru_shard *shard,
+                 struct mida_lru_node *node,
+                 struct mida_lru_node **dead)
+{
+    mida_map_unlink(&shard->map, __mida_lru_base(lru, node));
+    __mida_lru_unlink(node);
+    shard->bytes -= node->bytes;
+    if (node->refs) {
+        __atomic_store_n(&node->state, __MIDA_LRU_EVICTED, __ATOMIC_RELEASE);
+    }
+    else {
+        __atomic_store_n(&node->state, __MIDA_LRU_FREE, __ATOMIC_RELEASE);
+        node->next = *dead;
+        *dead = node;
+    }
+}
+
+static void
+__mida_lru_release_dead(struct mida_lru *lru, struct mida_lru_node *dead)
+{
+    while (dead) {
+        struct mida_lru_node *next = dead->next;
+
+        if (lru->evict) lru->evict(__mida_lru_base(lru, dead), lru->context);
+        dead = next;
+    }
+}
+
+MIDA_API void
+mida_lru_cleanup(struct mida_lru *lru)
+{
+    size_t i;
+
+    for (i = 0; i < MIDA_LRU_SHARDS; ++i) {
+        struct mida_lru_shard *shard = &lru->shards[i];
+        struct mida_lru_node *dead = NULL;
+
+        __mida_spin_lock(&shard->lock);
+        while (shard->list.next != &shard->list)
+            __mida_lru_evict(lru, shard, shard->list.next, &dead);
+        mida_map_cleanup(&shard->map);
+        __mida_spin_unlock(&shard->lock);
+        __mida_lru_release_dead(lru, dead);
+    }
+}
+
+MIDA_API int
+mida_lru_put(struct mida_lru *lru,
+             void *base,
+             const uint64_t hash,
+             const void *key,
+             const size_t bytes)
+{
+    struct mida_lru_shard *shard = __mida_lru_shard(lru, hash);
+    struct mida_lru_node *node = __mida_lru_node(lru, base), *dead = NULL;
+    void *old;
+
+    /* an object cached or referenced from another shard is guarded by
+     * another lock, it could not be moved here safely */
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != __MIDA_LRU_FREE
+        && __mida_lru_shard(lru, node->hnode.hash) != shard)
+        return -1;
+    __mida_spin_lock(&shard->lock);
+    old = mida_map_find(&shard->map, hash, key);
+    if (node->state == __MIDA_LRU_CACHED) {
+        if (old != base) {
+            /* cached under another key */
+            __mida_spin_unlock(&shard->lock);
+            return -1;
+        }
+        /* putting the cached object again only refreshes its accounting */
+        __mida_lru_unlink(node);
+        shard->bytes -= node->bytes;
+    }
+    else {
+        if (old)
+            __mida_lru_evict(lru, shard, __mida_lru_node(lru, old), &dead);
+        if (mida_map_insert(&shard->map, base, hash)) {
+            __mida_spin_unlock(&shard->lock);
+            __mida_lru_release_dead(lru, dead);
+            return -1;
+        }
+        /* the references of an object evicted while held are kept */
+        __atomic_store_n(&node->state, __MIDA_LRU_CACHED, __ATOMIC_RELEASE);
+    }
+    node->bytes = bytes;
+    __mida_lru_push_front(shard, node);
+    shard->bytes += bytes;
+    while (shard->bytes > shard->budget && shard->list.prev != node)
+        __mida_lru_evict(lru, shard, shard->list.prev, &dead);
+    __mida_spin_unlock(&shard->lock);
+    __mida_lru_release_dead(lru, dead);
+    return 0;
+}
+
+MIDA_API void *
+mida_lru_get(struct mida_lru *lru, const uint64_t hash, const void *key)
+{
+    struct mida_lru_shard *shard = __mida_lru_shard(lru, hash);
+    void *base;
+
+    __mida_spin_lock(&shard->lock);
+    if ((base = mida_map_find(&shard->map, hash, key)) != NULL) {
+        struct mida_lru_node *node = __mida_lru_node(lru, base);
+
+        __mida_lru_unlink(node);
+        __mida_lru_push_front(shard, node);
+        ++node->refs;
+        ++shard->hits;
+    }
+    else {
+        ++shard->misses;
+    }
+    __mida_spin_unlock(&shard->lock);
+    return base;
+}
+
+MIDA_API void
+mida_lru_release(struct mida_lru *lru, void *base)
+{
+    struct mida_lru_node *node = __mida_lru_node(lru, base);
+    struct mida_lru_shard *shard = __mida_lru_shard(lru, node->hnode.hash);
+    int dead;
+
+    __mida_spin_lock(&shard->lock);
+    dead = !--node->refs && node->state == __MIDA_LRU_EVICTED;
+    if (dead)
+        __atomic_store_n(&node->state, __MIDA_LRU_FREE, __ATOMIC_RELEASE);
+    __mida_spin_unlock(&shard->lock);
+    if (dead && lru->evict) lru->evict(base, lru->context);
+}
+
+MIDA_API void
+mida_lru_stats(struct mida_lru *lru,
+               size_t *hits,
+               size_t *misses,
+               size_t *bytes)
+{
+    size_t i, total[3] = { 0, 0, 0 };
+
+    for (i = 0; i < MIDA_LRU_SHARDS; ++i) {
+        struct mida_lru_shard *shard = &lru->shards[i];
+
+        __mida_spin_lock(&shard->lock);
+        total[0] += shard->hits;
+        total[1] += shard->misses;
+        total[2] += shard->bytes;
+        __mida_spin_unlock(&shard->lock);
+    }
+    if (hits) *hits = total[0];
+    if (misses) *misses = total[1];
+    if (bytes) *bytes = total[2];
+}
+
+#undef __mida_lru_node
+#undef __mida_lru_base
+#undef __mida_lru_shard
+#undef __MIDA_LRU_FREE
+#undef __MIDA_LRU_CACHED
+#undef __MIDA_LRU_EVICTED
+
+#endif /* MIDA_WITH_ATOMICS */
+
+#if defined(MIDA_WITH_ATOMICS) && defined(MIDA_WITH_POSIX)
+
+#include <pthread.h>
+#include <unistd.h>
+
+/* chunks left to a thread, as `tail << 32 | head`: the owner takes them from
+ * the head, thieves take the upper half */
+struct __mida_deque {
+    uint64_t range;
+    unsigned char pad[MIDA_CACHELINE - sizeof(uint64_t)];
+};
+
+struct __mida_job {
+    void *base;
+    size_t length;
+    size_t chunk;
+    void (*fn)(void *base, size_t first, size_t last, void *context);
+    void (*reduce)(
+        void *base, size_t first, size_t last, void *partial, void *context);
+    unsigned char *partials;
+    size_t stride;
+    unsigned threads;
+    void *context;
+};
+
+static pthread_mutex_t __mida_parallel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t __mida_parallel_job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __mida_parallel_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t __mida_parallel_done = PTHREAD_COND_INITIALIZER;
+static pthread_t *__mida_parallel_workers;
+static struct __mida_deque *__mida_parallel_deques;
+static const struct __mida_job *__mida_parallel_job;
+static unsigned long __mida_parallel_generation;
+static unsigned __mida_parallel_size;
+static unsigned __mida_parallel_pending;
+static int __mida_parallel_running;
+
+#define __MIDA_DEQUE(_head, _tail) ((uint64_t)(_tail) << 32 | (_head))
+
+static void
+__mida_job_chunk(const struct __mida_job *job,
+                 const unsigned id,
+                 const size_t index)
+{
+    const size_t first = index * job->chunk;
+    const size_t last = job->length - first > job->chunk ? first + job->chunk
+                                                         : job->length;
+
+    if (job->reduce)
+        job->reduce(job->base, first, last,
+                    job->partials + id * job->stride, job->context);
+    else
+        job->fn(job->base, first, last, job->context);
+}
+
+static void
+__mida_job_run(const struct __mida_job *job, const unsigned id)
+{
+    uint64_t *own = &__mida_parallel_deques[id].range;
+    unsigned i;
+
+    for (;;) {
+        uint64_t range = __atomic_load_n(own, __ATOMIC_ACQUIRE);
+        uint32_t head = (uint32_t)range, tail = (uint32_t)(range >> 32);
+
+        if (head < tail) {
+            if (__atomic_compare_exchange_n(own, &range,
+                                            __MIDA_DEQUE(head + 1, tail), 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE))
+                __mida_job_chunk(job, id, head);
+            continue;
+        }
+        /* out of chunks, steal the upper half of a victim's */
+        for (i = 1; i < __mida_parallel_size; ++i) {
+            uint64_t *victim =
+                &__mida_parallel_deques[(id + i) % __mida_parallel_size].range;
+            uint32_t mid;
+
+            range = __atomic_load_n(victim, __ATOMIC_ACQUIRE);
+            head = (uint32_t)range, tail = (uint32_t)(range >> 32);
+            if (head >= tail) continue;
+            mid = head + (tail - head) / 2;
+            if (!__atomic_compare_exchange_n(victim, &range,
+                                             __MIDA_DEQUE(head, mid), 0,
+                                             __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+            {
+                --i; /* retry the same victim */
+                continue;
+            }
+            /* only its owner refills an empty deque */
+            __atomic_store_n(own, __MIDA_DEQUE(mid + 1, tail),
+                             __ATOMIC_RELEASE);
+            __mida_job_chunk(job, id, mid);
+            break;
+        }
+        if (i == __mida_parallel_size) return;
+    }
+}
+
+static void *
+__mida_parallel_run(void *arg)
+{
+    const unsigned id = (unsigned)(size_t)arg;
+    unsigned long generation = 0; /* workers may start after the first job */
+
+    pthread_mutex_lock(&__mida_parallel_lock);
+    for (;;) {
+        const struct __mida_job *job;
+
+        while (__mida_parallel_running
+               && generation == __mida_parallel_generation)
+            pthread_cond_wait(&__mida_parallel_wake, &__mida_parallel_lock);
+        if (!__mida_parallel_running) break;
+        generation = __mida_parallel_generation;
+        job = __mida_parallel_job;
+        pthread_mutex_unlock(&__mida_parallel_lock);
+        __mida_job_run(job, id);
+        pthread_mutex_lock(&__mida_parallel_lock);
+        if (--__mida_parallel_pending == 0)
+            pthread_cond_signal(&__mida_parallel_done);
+    }
+    pthread_mutex_unlock(&__mida_parallel_lock);
+    return NULL;
+}
+
+static void
+__mida_parallel_join(const unsigned count)
+{
+    unsigned i;
+
+    pthread_mutex_lock(&__mida_parallel_lock);
+    __mida_parallel_running = 0;
+    pthread_cond_broadcast(&__mida_parallel_wake);
+    pthread_mutex_unlock(&__mida_parallel_lock);
+    for (i = 0; i < count; ++i)
+        pthread_join(__mida_parallel_workers[i], NULL);
+    free(__mida_parallel_workers);
+    free(__mida_parallel_deques);
+    __mida_parallel_workers = NULL;
+    __mida_parallel_deques = NULL;
+    __mida_parallel_size = 0;
+}
+
+MIDA_API int
+mida_parallel_start(unsigned threads)
+{
+    unsigned i;
+
+    pthread_mutex_lock(&__mida_parallel_lock);
+    if (__mida_parallel_running) {
+        pthread_mutex_unlock(&__mida_parallel_lock);
+        return -1;
+    }
+#ifdef _SC_NPROCESSORS_ONLN
+    if (!threads) {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+#endif /* _SC_NPROCESSORS_ONLN */
+    if (!threads) threads = 1;
+    if (!(__mida_parallel_deques =
+              calloc(threads, sizeof *__mida_parallel_deques))
+        || !(__mida_parallel_workers =
+                 calloc(threads, sizeof *__mida_parallel_workers)))
+    {
+        free(__mida_parallel_deques);
+        __mida_parallel_deques = NULL;
+        pthread_mutex_unlock(&__mida_parallel_lock);
+        return -1;
+    }
+    __mida_parallel_size = threads;
+    __mida_parallel_generation = 0;
+    __mida_parallel_running = 1;
+    pthread_mutex_unlock(&__mida_parallel_lock);
+    /* worker ids start at 1, the caller of a job being 0 */
+    for (i = 0; i + 1 < threads; ++i)
+        if (pthread_create(&__mida_parallel_workers[i], NULL,
+                           __mida_parallel_run, (void *)(size_t)(i + 1)))
+        {
+            __mida_parallel_join(i);
+            return -1;
+        }
+    return 0;
+}
+
+MIDA_API void
+mida_parallel_stop(void)
+{
+    pthread_mutex_lock(&__mida_parallel_job_lock);
+    pthread_mutex_lock(&__mida_parallel_lock);
+    if (__mida_parallel_running) {
+        pthread_mutex_unlock(&__mida_parallel_lock);
+        __mida_parallel_join(__mida_parallel_size - 1);
+    }
+    else {
+        pthread_mutex_unlock(&__mida_parallel_lock);
+    }
+    pthread_mutex_unlock(&__mida_parallel_job_lock);
+}
+
+/* runs a job across the pool, returns -1 if it must be run serially; the
+ * partial results of a reduction start as copies of `identity` */
+static int
+__mida_parallel_submit(struct __mida_job *job,
+                       const void *identity,
+                       const size_t size)
+{
+    size_t count;
+    unsigned i;
+
+    if (!__atomic_load_n(&__mida_parallel_running, __ATOMIC_ACQUIRE))
+        mida_parallel_start(0);
+    if (pthread_mutex_trylock(&__mida_parallel_job_lock)) return -1;
+    pthread_mutex_lock(&__mida_parallel_lock);
+    if (!__mida_parallel_running || __mida_parallel_size < 2) goto _serial;
+    if (!job->chunk)
+        job->chunk = job->length / (__mida_parallel_size * 16) + 1;
+    if (job->length / job->chunk >= UINT32_MAX)
+        job->chunk = job->length / (UINT32_MAX - 1) + 1;
+    count = (job->length + job->chunk - 1) / job->chunk;
+    if (count < 2) goto _serial;
+    if (job->reduce) {
+        /* a cache line apart, for threads not to write to the same one */
+        job->stride = (size + MIDA_CACHELINE - 1) / MIDA_CACHELINE
+                      * MIDA_CACHELINE;
+        if (!(job->partials = malloc(__mida_parallel_size * job->stride)))
+            goto _serial;
+        for (i = 0; i < __mida_parallel_size; ++i)
+            memcpy(job->partials + i * job->stride, identity, size);
+    }
+    for (i = 0; i < __mida_parallel_size; ++i)
+        __mida_parallel_deques[i].range =
+            __MIDA_DEQUE(count * i / __mida_parallel_size,
+                         count * (i + 1) / __mida_parallel_size);
+    job->threads = __mida_parallel_size;
+    __mida_parallel_job = job;
+    __mida_parallel_pending = __mida_parallel_size - 1;
+    ++__mida_parallel_generation;
+    pthread_cond_broadcast(&__mida_parallel_wake);
+    pthread_mutex_unlock(&__mida_parallel_lock);
+
+    __mida_job_run(job, 0);
+
+    pthread_mutex_lock(&__mida_parallel_lock);
+    while (__mida_parallel_pending)
+        pthread_cond_wait(&__mida_parallel_done, &__mida_parallel_lock);
+    pthread_mutex_unlock(&__mida_parallel_lock);
+    pthread_mutex_unlock(&__mida_parallel_job_lock);
+    return 0;
+
+_serial:
+    pthread_mutex_unlock(&__mida_parallel_lock);
+    pthread_mutex_unlock(&__mida_parallel_job_lock);
+    return -1;
+}
+
+MIDA_API void
+__mida_parallel_for(void *base,
+                    const size_t length,
+                    size_t chunk,
+                    void (*fn)(void *base,
+                               size_t first,
+                               size_t last,
+                               void *context),
+                    void *context)
+{
+    struct __mida_job job = { 0 };
+
+    if (!length) return;
+    job.base = base;
+    job.length = length;
+    job.chunk = chunk;
+    job.fn = fn;
+    job.context = context;
+    if (__mida_parallel_submit(&job, NULL, 0)) fn(base, 0, length, context);
+}
+
+MIDA_API void
+__mida_parallel_reduce(
+    void *base,
+    const size_t length,
+    size_t chunk,
+    void *result,
+    const size_t size,
+    void (*fn)(
+        void *base, size_t first, size_t last, void *partial, void *context),
+    void (*combine)(void *result, const void *partial, void *context),
+    void *context)
+{
+    struct __mida_job job = { 0 };
+    unsigned i;
+
+    if (!length) return;
+    job.base = base;
+    job.length = length;
+    job.chunk = chunk;
+    job.reduce = fn;
+    job.context = context;
+    if (__mida_parallel_submit(&job, result, size)) {
+        fn(base, 0, length, result, context);
+        return;
+    }
+    for (i = 0; i < job.threads; ++i)
+        combine(result, job.partials + i * job.stride, context);
+    free(job.partials);
+}
+
+#endif /* MIDA_WITH_ATOMICS && MIDA_WITH_POSIX */
+
+static void
+__mida_agg_scalar(const double *values,
+                  size_t i,
+                  const size_t n,
+                  struct mida_agg *agg)
+{
+    double sum = 0, min = agg->min, max = agg->max;
+
+    for (; i < n; ++i) {
+        sum += values[i];
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+    agg->sum += sum;
+    agg->min = min;
+    agg->max = max;
+}
+
+static void
+__mida_agg_int_scalar(const int *values,
+                      size_t i,
+                      const size_t n,
+                      struct mida_agg_int *agg)
+{
+    int64_t sum = 0;
+    int min = (int)agg->min, max = (int)agg->max;
+
+    for (; i < n; ++i) {
+        sum += values[i];
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+    agg->sum += sum;
+    agg->min = min;
+    agg->max = max;
+}
+
+/* the sum goes through uint64_t so that it wraps instead of overflowing */
+static void
+__mida_agg_int64_scalar(const int64_t *values,
+                        size_t i,
+                        const size_t n,
+                        struct mida_agg_int *agg)
+{
+    uint64_t sum = 0;
+    int64_t min = agg->min, max = agg->max;
+
+    for (; i < n; ++i) {
+        sum += (uint64_t)values[i];
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+    agg->sum = (int64_t)((uint64_t)agg->sum + sum);
+    agg->min = min;
+    agg->max = max;
+}
+
+#ifdef MIDA_WITH_SSE2
+
+#define __MIDA_AVX2 __attribute__((target("avx2")))
+
+/* two sums, each over every other pair, to hide the latency of the adds */
+static void
+__mida_agg_sse2(const double *values, const size_t n, struct mida_agg *agg)
+{
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd(),
+            min = _mm_set1_pd(values[0]), max = min;
+    double lanes[2];
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128d a = _mm_loadu_pd(values + i),
+                      b = _mm_loadu_pd(values + i + 2);
+
+        sum0 = _mm_add_pd(sum0, a);
+        sum1 = _mm_add_pd(sum1, b);
+        min = _mm_min_pd(min, _mm_min_pd(a, b));
+        max = _mm_max_pd(max, _mm_max_pd(a, b));
+    }
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    agg->sum = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, min);
+    agg->min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, max);
+    agg->max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    __mida_agg_scalar(values, i, n, agg);
+}
+
+__MIDA_AVX2 static void
+__mida_agg_avx2(const double *values, const size_t n, struct mida_agg *agg)
+{
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd(),
+            min = _mm256_set1_pd(values[0]), max = min;
+    double lanes[4];
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256d a = _mm256_loadu_pd(values + i),
+                      b = _mm256_loadu_pd(values + i + 4);
+
+        sum0 = _mm256_add_pd(sum0, a);
+        sum1 = _mm256_add_pd(sum1, b);
+        min = _mm256_min_pd(min, _mm256_min_pd(a, b));
+        max = _mm256_max_pd(max, _mm256_max_pd(a, b));
+    }
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+    agg->sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, min);
+    agg->min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    if (lanes[2] < agg->min) agg->min = lanes[2];
+    if (lanes[3] < agg->min) agg->min = lanes[3];
+    _mm256_storeu_pd(lanes, max);
+    agg->max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    if (lanes[2] > agg->max) agg->max = lanes[2];
+    if (lanes[3] > agg->max) agg->max = lanes[3];
+    __mida_agg_scalar(values, i, n, agg);
+}
+
+/* SSE2 has neither 32-bit min/max nor sign extension, so both are built
+ * from compares and shifts; the sums are widened to 64-bit lanes */
+static void
+__mida_agg_int_sse2(const int *values,
+                    const size_t n,
+                    struct mida_agg_int *agg)
+{
+    __m128i sum = _mm_setzero_si128(), min = _mm_set1_epi32(values[0]),
+            max = min;
+    int lanes[4];
+    int64_t sums[2];
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(values + i)),
+                      sign = _mm_srai_epi32(a, 31),
+                      lt = _mm_cmplt_epi32(a, min),
+                      gt = _mm_cmpgt_epi32(a, max);
+
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(a, sign));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(a, sign));
+        min = _mm_or_si128(_mm_and_si128(lt, a), _mm_andnot_si128(lt, min));
+        max = _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, max));
+    }
+    _mm_storeu_si128((__m128i *)sums, sum);
+    agg->sum = sums[0] + sums[1];
+    _mm_storeu_si128((__m128i *)lanes, min);
+    agg->min = lanes[0];
+    for (i = 1; i < 4; ++i)
+        if (lanes[i] < agg->min) agg->min = lanes[i];
+    _mm_storeu_si128((__m128i *)lanes, max);
+    agg->max = lanes[0];
+    for (i = 1; i < 4; ++i)
+        if (lanes[i] > agg->max) agg->max = lanes[i];
+    __mida_agg_int_scalar(values, n & ~(size_t)3, n, agg);
+}
+
+__MIDA_AVX2 static void
+__mida_agg_int_avx2(const int *values,
+                    const size_t n,
+                    struct mida_agg_int *agg)
+{
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = sum0,
+            min = _mm256_set1_epi32(values[0]), max = min;
+    int lanes[8];
+    int64_t sums[4];
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(values + i));
+
+        sum0 = _mm256_add_epi64(
+            sum0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(a)));
+        sum1 = _mm256_add_epi64(
+            sum1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(a, 1)));
+        min = _mm256_min_epi32(min, a);
+        max = _mm256_max_epi32(max, a);
+    }
+    _mm256_storeu_si256((__m256i *)sums, _mm256_add_epi64(sum0, sum1));
+    agg->sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    _mm256_storeu_si256((__m256i *)lanes, min);
+    agg->min = lanes[0];
+    for (i = 1; i < 8; ++i)
+        if (lanes[i] < agg->min) agg->min = lanes[i];
+    _mm256_storeu_si256((__m256i *)lanes, max);
+    agg->max = lanes[0];
+    for (i = 1; i < 8; ++i)
+        if (lanes[i] > agg->max) agg->max = lanes[i];
+    __mida_agg_int_scalar(values, n & ~(size_t)7, n, agg);
+}
+
+/* 64-bit compares need SSE4.2, so without AVX2 the scalar loop is used */
+__MIDA_AVX2 static void
+__mida_agg_int64_avx2(const int64_t *values,
+                      const size_t n,
+                      struct mida_agg_int *agg)
+{
+    __m256i sum = _mm256_setzero_si256(), min = _mm256_set1_epi64x(values[0]),
+            max = min;
+    int64_t lanes[4];
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(values + i));
+
+        sum = _mm256_add_epi64(sum, a);
+        min = _mm256_blendv_epi8(min, a, _mm256_cmpgt_epi64(min, a));
+        max = _mm256_blendv_epi8(max, a, _mm256_cmpgt_epi64(a, max));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+    agg->sum = (int64_t)(((uint64_t)lanes[0] + (uint64_t)lanes[1])
+                         + ((uint64_t)lanes[2] + (uint64_t)lanes[3]));
+    _mm256_storeu_si256((__m256i *)lanes, min);
+    agg->min = lanes[0];
+    for (i = 1; i < 4; ++i)
+        if (lanes[i] < agg->min) agg->min = lanes[i];
+    _mm256_storeu_si256((__m256i *)lanes, max);
+    agg->max = lanes[0];
+    for (i = 1; i < 4; ++i)
+        if (lanes[i] > agg->max) agg->max = lanes[i];
+    __mida_agg_int64_scalar(values, n & ~(size_t)3, n, agg);
+}
+
+#undef __MIDA_AVX2
+
+#endif /* MIDA_WITH_SSE2 */
+
+MIDA_API const struct mida_agg *
+__mida_agg(struct mida_agg *agg, const double *base, const size_t length)
+{
+    if (agg->cached == agg->version + 1 && agg->length == length) return agg;
+    agg->sum = agg->min = agg->max = agg->mean = 0;
+    if (length) {
+#ifdef MIDA_WITH_SSE2
+        if (__mida_has_avx2())
+            __mida_agg_avx2(base, length, agg);
+        else
+            __mida_agg_sse2(base, length, agg);
+#else
+        agg->min = agg->max = base[0];
+        __mida_agg_scalar(base, 0, length, agg);
+#endif /* MIDA_WITH_SSE2 */
+        agg->mean = agg->sum / (double)length;
+    }
+    agg->length = length;
+    agg->cached = agg->version + 1;
+    return agg;
+}
+
+MIDA_API const struct mida_agg_int *
+__mida_agg_int(struct mida_agg_int *agg, const int *base, const size_t length)
+{
+    if (agg->cached == agg->version + 1 && agg->length == length) return agg;
+    agg->sum = agg->min = agg->max = 0;
+    agg->mean = 0;
+    if (length) {
+#ifdef MIDA_WITH_SSE2
+        if (__mida_has_avx2())
+            __mida_agg_int_avx2(base, length, agg);
+        else
+            __mida_agg_int_sse2(base, length, agg);
+#else
+        agg->min = agg->max = base[0];
+        __mida_agg_int_scalar(base, 0, length, agg);
+#endif /* MIDA_WITH_SSE2 */
+        agg->mean = (double)agg->sum / (double)length;
+    }
+    agg->length = length;
+    agg->cached = agg->version + 1;
+    return agg;
+}
+
+MIDA_API const struct mida_agg_int *
+__mida_agg_int64(struct mida_agg_int *agg,
+                 const int64_t *base,
+                 const size_t length)
+{
+    if (agg->cached == agg->version + 1 && agg->length == length) return agg;
+    agg->sum = agg->min = agg->max = 0;
+    agg->mean = 0;
+    if (length) {
+#ifdef MIDA_WITH_SSE2
+        if (__mida_has_avx2()) {
+            __mida_agg_int64_avx2(base, length, agg);
+        }
+        else
+#endif /* MIDA_WITH_SSE2 */
+        {
+            agg->min = agg->max = base[0];
+            __mida_agg_int64_scalar(base, 0, length, agg);
+        }
+        agg->mean = (double)agg->sum / (double)length;
+    }
+    agg->length = length;
+    agg->cached = agg->version + 1;
+    return agg;
+}
+
+static void
+__mida_zone_add(struct mida_zone *zone, const int64_t value)
+{
+    if (value == MIDA_COLUMN_NULL) {
+        ++zone->nulls;
+        return;
+    }
+    if (value < zone->min) zone->min = value;
+    if (value > zone->max) zone->max = value;
+}
+
+static void
+__mida_zone_reset(struct mida_zone *zone)
+{
+    zone->min = INT64_MAX;
+    zone->max = INT64_MIN;
+    zone->nulls = 0;
+}
+
+MIDA_API int64_t *
+mida_column_new(const size_t capacity)
+{
+    const size_t blocks =
+        (capacity + MIDA_COLUMN_BLOCK - 1) / MIDA_COLUMN_BLOCK;
+    struct mida_zone *zones = NULL;
+    int64_t *column;
+
+    if (blocks && !(zones = malloc(blocks * sizeof *zones))) return NULL;
+    if (!(column = mida_malloc(struct mida_column, sizeof *column, capacity)))
+    {
+        free(zones);
+        return NULL;
+    }
+    MIDA(struct mida_column, column)->length = 0;
+    MIDA(struct mida_column, column)->capacity = capacity;
+    MIDA(struct mida_column, column)->zones = zones;
+    return column;
+}
+
+MIDA_API size_t
+mida_column_length(const int64_t *column)
+{
+    return column ? MIDA(struct mida_column, column)->length : 0;
+}
+
+static int
+__mida_column_grow(int64_t **p_column)
+{
+    struct mida_column *container = MIDA(struct mida_column, *p_column);
+    const size_t capacity =
+        container->capacity ? container->capacity * 2 : MIDA_COLUMN_BLOCK;
+    struct mida_zone *zones =
+        realloc(container->zones,
+                (capacity + MIDA_COLUMN_BLOCK - 1) / MIDA_COLUMN_BLOCK
+                    * sizeof *zones);
+    int64_t *column;
+
+    if (!zones) return -1;
+    container->zones = zones;
+    column = mida_realloc(struct mida_column, *p_column, sizeof *column,
+                          capacity);
+    if (!column) return -1;
+    MIDA(struct mida_column, column)->capacity = capacity;
+    *p_column = column;
+    return 0;
+}
+
+MIDA_API int
+mida_column_push(int64_t **p_column, const int64_t value)
+{
+    struct mida_column *container;
+    struct mida_zone *zone;
+
+    if (!*p_column && !(*p_column = mida_column_new(MIDA_COLUMN_BLOCK)))
+        return -1;
+    container = MIDA(struct mida_column, *p_column);
+    if (container->length == container->capacity) {
+        if (__mida_column_grow(p_column)) return -1;
+        container = MIDA(struct mida_column, *p_column);
+    }
+    zone = &container->zones[container->length / MIDA_COLUMN_BLOCK];
+    if (container->length % MIDA_COLUMN_BLOCK == 0) __mida_zone_reset(zone);
+    __mida_zone_add(zone, value);
+    (*p_column)[container->length++] = value;
+    return 0;
+}
+
+MIDA_API void
+mida_column_set(int64_t *column, const size_t index, const int64_t value)
+{
+    const struct mida_column *container = MIDA(struct mida_column, column);
+    const size_t block = index / MIDA_COLUMN_BLOCK;
+    struct mida_zone *zone = &container->zones[block];
+    const int64_t old = column[index];
+
+    column[index] = value;
+    if (old == value) return;
+    if (old == MIDA_COLUMN_NULL) {
+        --zone->nulls;
+        __mida_zone_add(zone, value);
+    }
+    else if (old == zone->min || old == zone->max) {
+        /* the bound may have gone, shrink the zone back */
+        const size_t first = block * MIDA_COLUMN_BLOCK,
+                     last = container->length - first > MIDA_COLUMN_BLOCK
+                                ? first + MIDA_COLUMN_BLOCK
+                                : container->length;
+        size_t i;
+
+        __mida_zone_reset(zone);
+        for (i = first; i < last; ++i)
+            __mida_zone_add(zone, column[i]);
+    }
+    else {
+        __mida_zone_add(zone, value);
+    }
+}
+
+static size_t
+__mida_column_match_scalar(const int64_t *column,
+                           size_t i,
+                           const size_t last,
+                           const int64_t lo,
+                           const int64_t hi,
+                           void (*fn)(size_t index,
+                                      int64_t value,
+                                      void *context),
+                           void *context)
+{
+    /* a single unsigned compare, as lo <= hi */
+    const uint64_t range = (uint64_t)hi - (uint64_t)lo;
+    size_t count = 0;
+
+    if (!fn) {
+        for (; i < last; ++i)
+            count += (uint64_t)column[i] - (uint64_t)lo <= range;
+        return count;
+    }
+    for (; i < last; ++i)
+        if ((uint64_t)column[i] - (uint64_t)lo <= range) {
+            fn(i, column[i], context);
+            ++count;
+        }
+    return count;
+}
+
+#ifdef MIDA_WITH_SSE2
+
+/* 64-bit compares need AVX2, SSE2 only has them from SSE4.2 on */
+__attribute__((target("avx2"))) static size_t
+__mida_column_match_avx2(const int64_t *column,
+                         size_t i,
+                         const size_t last,
+                         const int64_t lo,
+                         const int64_t hi,
+                         void (*fn)(size_t index,
+                                    int64_t value,
+                                    void *context),
+                         void *context)
+{
+    const __m256i below = _mm256_set1_epi64x(lo - 1),
+                  above = _mm256_set1_epi64x(hi);
+    size_t count = 0;
+
+    for (; i + 4 <= last; i += 4) {
+        const __m256i values =
+            _mm256_loadu_si256((const __m256i *)(column + i));
+        unsigned mask = (unsigned)_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_andnot_si256(
+                _mm256_cmpgt_epi64(values, above),
+                _mm256_cmpgt_epi64(values, below))));
+
+        if (!fn) {
+            count += (size_t)__builtin_popcount(mask);
+            continue;
+        }
+        for (; mask; mask &= mask - 1) {
+            const size_t at = i + (size_t)__builtin_ctz(mask);
+
+            fn(at, column[at], context);
+            ++count;
+        }
+    }
+    return count
+           + __mida_column_match_scalar(column, i, last, lo, hi, fn, context);
+}
+
+static size_t
+__mida_column_match(const int64_t *column,
+                    const size_t first,
+                    const size_t last,
+                    const int64_t lo,
+                    const int64_t hi,
+                    void (*fn)(size_t index, int64_t value, void *context),
+                    void *context)
+{
+    return __mida_has_avx2() ? __mida_column_match_avx2(column, first, last,
+                                                        lo, hi, fn, context)
+                             : __mida_column_match_scalar(
+                                 column, first, last, lo, hi, fn, context);
+}
+
+#else
+
+#define __mida_column_match __mida_column_match_scalar
+
+#endif /* MIDA_WITH_SSE2 */
+
+MIDA_API size_t
+mida_column_scan(const int64_t *column,
+                 int64_t lo,
+                 const int64_t hi,
+                 void (*fn)(size_t index, int64_t value, void *context),
+                 void *context)
+{
+    const struct mida_column *container = MIDA(struct mida_column, column);
+    size_t first, count = 0;
+
+    /* nulls never match */
+    if (lo == MIDA_COLUMN_NULL) ++lo;
+    if (lo > hi) return 0;
+    for (first = 0; first < container->length; first += MIDA_COLUMN_BLOCK) {
+        const struct mida_zone *zone =
+            &container->zones[first / MIDA_COLUMN_BLOCK];
+        const size_t last = container->length - first > MIDA_COLUMN_BLOCK
+                                ? first + MIDA_COLUMN_BLOCK
+                                : container->length;
+        size_t i;
+
+        if (zone->max < lo || zone->min > hi) continue;
+        if (zone->min >= lo && zone->max <= hi && !zone->nulls) {
+            /* the whole block matches */
+            if (fn)
+                for (i = first; i < last; ++i)
+                    fn(i, column[i], context);
+            count += last - first;
+            continue;
+        }
+        count +=
+            __mida_column_match(column, first, last, lo, hi, fn, context);
+    }
+    return count;
+}
+
+#undef __mida_column_match
+
+MIDA_API void
+mida_column_free(int64_t *column)
+{
+    if (!column) return;
+    free(MIDA(struct mida_column, column)->zones);
+    mida_free(struct mida_column, column);
+}
+
+/* low `_w` bits set, for `_w` from 1 to 64 */
+#define __MIDA_PACK_MASK(_w) (~(uint64_t)0 >> (64 - (_w)))
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/* every 8 values of width `_w` fill exactly `_w` bytes, so within such a
+ * group each value is one unaligned load at a constant byte offset followed
+ * by constant shift and mask; unrolling a group rather than the whole block
+ * keeps the code at a few hundred bytes per width. A value must fit a load
+ * along with its shift of up to 7 bits, hence widths up to 57, and the
+ * groups too close to the end of the block for a load are left to the word
+ * loop */
+#define __MIDA_PACK_WIDTHS(_X)                                                \
+    _X(1) _X(2) _X(3) _X(4) _X(5) _X(6) _X(7) _X(8) _X(9) _X(10) _X(11)       \
+    _X(12) _X(13) _X(14) _X(15) _X(16) _X(17) _X(18) _X(19) _X(20) _X(21)     \
+    _X(22) _X(23) _X(24) _X(25) _X(26) _X(27) _X(28) _X(29) _X(30) _X(31)     \
+    _X(32) _X(33) _X(34) _X(35) _X(36) _X(37) _X(38) _X(39) _X(40) _X(41)     \
+    _X(42) _X(43) _X(44) _X(45) _X(46) _X(47) _X(48) _X(49) _X(50) _X(51)     \
+    _X(52) _X(53) _X(54) _X(55) _X(56) _X(57)
+
+#define __MIDA_UNPACK_ONE(_w, _j)                                             \
+    memcpy(&value, group + (_j) * (_w) / 8, sizeof value);                    \
+    out[i + (_j)] =                                                           \
+        ((value >> ((_j) * (_w) % 8)) & __MIDA_PACK_MASK(_w)) + reference;
+
+#define __MIDA_UNPACK_CASE(_w)                                                \
+    case _w:                                                                  \
+        for (i = 0; (i / 8 + 1) * (_w) + 8 <= MIDA_PACK_BLOCK / 8 * (_w);     \
+             i += 8) {                                                        \
+            const unsigned char *group = bytes + i / 8 * (_w);                \
+            __MIDA_UNPACK_ONE(_w, 0) __MIDA_UNPACK_ONE(_w, 1)                 \
+            __MIDA_UNPACK_ONE(_w, 2) __MIDA_UNPACK_ONE(_w, 3)                 \
+            __MIDA_UNPACK_ONE(_w, 4) __MIDA_UNPACK_ONE(_w, 5)                 \
+            __MIDA_UNPACK_ONE(_w, 6) __MIDA_UNPACK_ONE(_w, 7)                 \
+        }                                                                     \
+        break;
+
+#endif /* __BYTE_ORDER__ */
+
+/* a block of MIDA_PACK_BLOCK values of width `width` takes exactly
+ * `2 * width` words */
+static void
+__mida_pack_words(uint64_t *words, const unsigned width, const uint64_t *in)
+{
+    size_t i, bit;
+
+    if (!width) return;
+    for (i = 0, bit = 0; i < MIDA_PACK_BLOCK; ++i, bit += width) {
+        const unsigned shift = (unsigned)(bit & 63);
+
+        words[bit >> 6] |= in[i] << shift;
+        if (shift + width > 64)
+            words[(bit >> 6) + 1] |= in[i] >> (64 - shift);
+    }
+}
+
+/* adds `reference` to every value */
+static void
+__mida_unpack_words(const uint64_t *words,
+                    const unsigned width,
+                    const uint64_t reference,
+                    uint64_t *out)
+{
+    size_t i = 0, bit;
+#ifdef __MIDA_UNPACK_CASE
+    const unsigned char *bytes = (const unsigned char *)words;
+    uint64_t value;
+#endif /* __MIDA_UNPACK_CASE */
+
+    if (!width) {
+        for (; i < MIDA_PACK_BLOCK; ++i)
+            out[i] = reference;
+        return;
+    }
+#ifdef __MIDA_UNPACK_CASE
+    switch (width) {
+        __MIDA_PACK_WIDTHS(__MIDA_UNPACK_CASE)
+    default:
+        break;
+    }
+#endif /* __MIDA_UNPACK_CASE */
+    for (bit = i * width; i < MIDA_PACK_BLOCK; ++i, bit += width) {
+        const unsigned shift = (unsigned)(bit & 63);
+        uint64_t word = words[bit >> 6] >> shift;
+        if (shift + width > 64) word |= words[(bit >> 6) + 1] << (64 - shift);
+        out[i] = (word & __MIDA_PACK_MASK(width)) + reference;
+    }
+}
+
+#undef __MIDA_PACK_WIDTHS
+#undef __MIDA_UNPACK_ONE
+#undef __MIDA_UNPACK_CASE
+
+static uint64_t
+__mida_unpack_one(const uint64_t *words, const unsigned width, size_t i)
+{
+    const size_t bit = i * width;
+    const unsigned shift = (unsigned)(bit & 63);
+    uint64_t value;
+
+    if (!width) return 0;
+    value = words[bit >> 6] >> shift;
+    if (shift + width > 64) value |= words[(bit >> 6) + 1] << (64 - shift);
+    return value & __MIDA_PACK_MASK(width);
+}
+
+static unsigned
+__mida_pack_width(uint64_t range)
+{
+    unsigned width = 0;
+
+    for (; range; range >>= 1)
+        ++width;
+    return width;
+}
+
+/* picks the narrowest encoding of a block of `n` values */
+static void
+__mida_pack_plan(const int64_t *values,
+                 const size_t n,
+                 struct mida_pack_block *block)
+{
+    int64_t min = values[0], max = values[0];
+    size_t i;
+
+    for (i = 1; i < n; ++i) {
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+    block->first = values[0];
+    block->reference = min;
+    block->encoding = MIDA_PACK_FOR;
+    block->width =
+        (unsigned char)__mida_pack_width((uint64_t)max - (uint64_t)min);
+    /* differences can't overflow within a range this narrow */
+    if (n > 1 && block->width < 63) {
+        int64_t dmin = values[1] - values[0], dmax = dmin;
+        unsigned width;
+
+        for (i = 2; i < n; ++i) {
+            const int64_t delta = values[i] - values[i - 1];
+
+            if (delta < dmin) dmin = delta;
+            if (delta > dmax) dmax = delta;
+        }
+        width = __mida_pack_width((uint64_t)(dmax - dmin));
+        if (width < block->width) {
+            block->reference = dmin;
+            block->encoding = MIDA_PACK_DELTA;
+            block->width = (unsigned char)width;
+        }
+    }
+}
+
+MIDA_API uint64_t *
+mida_pack(const int64_t *values, const size_t length)
+{
+    const size_t count = (length + MIDA_PACK_BLOCK - 1) / MIDA_PACK_BLOCK;
+    struct mida_pack_block *blocks =
+        malloc((count ? count : 1) * sizeof *blocks);
+    uint64_t in[MIDA_PACK_BLOCK], *packed;
+    size_t b, words = 0;
+
+    if (!blocks) return NULL;
+    for (b = 0; b < count; ++b) {
+        const size_t first = b * MIDA_PACK_BLOCK,
+                     n = length - first > MIDA_PACK_BLOCK ? MIDA_PACK_BLOCK
+                                                          : length - first;
+
+        __mida_pack_plan(values + first, n, &blocks[b]);
+        blocks[b].offset = words;
+        words += 2 * (size_t)blocks[b].width;
+    }
+    if (!(packed = mida_calloc(struct mida_packed, sizeof *packed, words))) {
+        free(blocks);
+        return NULL;
+    }
+    for (b = 0; b < count; ++b) {
+        const struct mida_pack_block *block = &blocks[b];
+        const int64_t *block_values = values + b * MIDA_PACK_BLOCK;
+        const size_t n = length - b * MIDA_PACK_BLOCK > MIDA_PACK_BLOCK
+                             ? MIDA_PACK_BLOCK
+                             : length - b * MIDA_PACK_BLOCK;
+        size_t i;
+
+        if (block->encoding == MIDA_PACK_FOR) {
+            for (i = 0; i < n; ++i)
+                in[i] = (uint64_t)block_values[i] - (uint64_t)block->reference;
+        }
+        else {
+            in[0] = 0;
+            for (i = 1; i < n; ++i)
+                in[i] = (uint64_t)(block_values[i] - block_values[i - 1]
+                                   - block->reference);
+        }
+        for (; i < MIDA_PACK_BLOCK; ++i)
+            in[i] = 0;
+        __mida_pack_words(packed + block->offset, block->width, in);
+    }
+    MIDA(struct mida_packed, packed)->length = length;
+    MIDA(struct mida_packed, packed)->words = words;
+    MIDA(struct mida_packed, packed)->blocks = blocks;
+    return packed;
+}
+
+MIDA_API size_t
+mida_pack_length(const uint64_t *packed)
+{
+    return packed ? MIDA(struct mida_packed, packed)->length : 0;
+}
+
+MIDA_API int64_t
+mida_pack_get(const uint64_t *packed, const size_t index)
+{
+    const struct mida_pack_block *block =
+        &MIDA(struct mida_packed, packed)->blocks[index / MIDA_PACK_BLOCK];
+    const size_t at = index % MIDA_PACK_BLOCK;
+    int64_t values[MIDA_PACK_BLOCK];
+
+    if (block->encoding == MIDA_PACK_FOR)
+        return (int64_t)((uint64_t)block->reference
+                         + __mida_unpack_one(packed + block->offset,
+                                             block->width, at));
+    /* differences need to be added up from the start of the block */
+    mida_pack_decode_block(packed, index / MIDA_PACK_BLOCK, values);
+    return values[at];
+}
+
+MIDA_API size_t
+mida_pack_decode_block(const uint64_t *packed,
+                       const size_t block,
+                       int64_t *values)
+{
+    const struct mida_packed *container = MIDA(struct mida_packed, packed);
+    const struct mida_pack_block *info = &container->blocks[block];
+    const size_t first = block * MIDA_PACK_BLOCK,
+                 n = container->length - first > MIDA_PACK_BLOCK
+                         ? MIDA_PACK_BLOCK
+                         : container->length - first;
+    /* decoded in place, int64_t and uint64_t may alias */
+    uint64_t *raw = (uint64_t *)values;
+    size_t i;
+
+    __mida_unpack_words(packed + info->offset, info->width,
+                        (uint64_t)info->reference, raw);
+    if (info->encoding == MIDA_PACK_DELTA) {
+        raw[0] = (uint64_t)info->first;
+        for (i = 1; i < n; ++i)
+            raw[i] += raw[i - 1];
+    }
+    return n;
+}
+
+MIDA_API size_t
+mida_pack_decode(const uint64_t *packed,
+                 const size_t first,
+                 size_t count,
+                 int64_t *values)
+{
+    const size_t length = mida_pack_length(packed);
+    size_t done = 0;
+
+    if (first >= length) return 0;
+    if (count > length - first) count = length - first;
+    while (done < count) {
+        const size_t index = first + done, at = index % MIDA_PACK_BLOCK,
+                     n = MIDA_PACK_BLOCK - at < count - done
+                             ? MIDA_PACK_BLOCK - at
+                             : count - done;
+
+        if (!at && n == MIDA_PACK_BLOCK) {
+            mida_pack_decode_block(packed, index / MIDA_PACK_BLOCK,
+                                   values + done);
+        }
+        else {
+            int64_t block[MIDA_PACK_BLOCK];
+
+            mida_pack_decode_block(packed, index / MIDA_PACK_BLOCK, block);
+            memcpy(values + done, block + at, n * sizeof *values);
+        }
+        done += n;
+    }
+    return count;
+}
+
+MIDA_API void
+mida_pack_free(uint64_t *packed)
+{
+    if (!packed) return;
+    free(MIDA(struct mida_packed, packed)->blocks);
+    mida_free(struct mida_packed, packed);
+}
+
+#undef __MIDA_PACK_MASK
+
+#undef _mida_data_from_container
+#undef _mida_container_from_data
+
+#endif /* MIDA_HEADER */
+
+#ifdef __cplusplus
+}
+
+#include <algorithm>
+
+/**
+ * @struct mida_vec
+ * @brief Growable array API specialized for an element type, the C++
+ *      counterpart of MIDA_DEFINE_VEC()
+ *
+ * `Container` needs `size_t length` and `size_t capacity` members, and
+ * `T` must be trivially copyable.
+ */
+template <typename Container, typename T> struct mida_vec {
+    static T *
+    make(const size_t capacity)
+    {
+        T *vec = static_cast<T *>(
+            mida_malloc(Container, sizeof(T), capacity));
+        if (vec) {
+            MIDA(Container, vec)->length = 0;
+            MIDA(Container, vec)->capacity = capacity;
+        }
+        return vec;
+    }
+
+    static size_t
+    length(const T *vec)
+    {
+        return vec ? MIDA(const Container, vec)->length : 0;
+    }
+
+    static int
+    reserve(T *&vec, const size_t capacity)
+    {
+        const size_t len = length(vec),
+                     current = vec ? MIDA(Container, vec)->capacity : 0;
+        size_t grown = std::max(std::max(current * 2, capacity), size_t(8));
+        T *moved;
+
+        if (vec && capacity <= current) return 0;
+        moved = static_cast<T *>(
+            mida_realloc(Container, vec, sizeof(T), grown));
+        if (!moved) return -1;
+        MIDA(Container, moved)->length = len;
+        MIDA(Container, moved)->capacity = grown;
+        vec = moved;
+        return 0;
+    }
+
+    static int
+    push(T *&vec, const T &value)
+    {
+        Container *container = vec ? MIDA(Container, vec) : NULL;
+        if (!container || container->length == container->capacity) {
+            if (reserve(vec, length(vec) + 1)) return -1;
+            container = MIDA(Container, vec);
+        }
+        vec[container->length++] = value;
+        return 0;
+    }
+
+    static T &
+    get(T *vec, const size_t index)
+    {
+        return vec[index];
+    }
+
+    static int
+    resize(T *&vec, const size_t len)
+    {
+        const size_t old = length(vec);
+        if (reserve(vec, len)) return -1;
+        if (len > old) std::fill(vec + old, vec + len, T());
+        MIDA(Container, vec)->length = len;
+        return 0;
+    }
+
+    template <typename Less>
+    static void
+    sort(T *vec, Less less)
+    {
+        std::sort(vec, vec + length(vec), less);
+    }
+
+    static void
+    sort(T *vec)
+    {
+        std::sort(vec, vec + length(vec));
+    }
+
+    static T *
+    find(T *vec, const T &value)
+    {
+        T *end = vec + length(vec), *found = std::find(vec, end, value);
+        return found != end ? found : NULL;
+    }
+
+    static void
+    destroy(T *vec)
+    {
+        if (vec) mida_free(Container, vec);
+    }
+};
 #endif /* __cplusplus */
 
 #endif /* MIDA_H */
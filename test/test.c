@@ -1,3 +1,10 @@
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "greatest.h"
 #include "mida.h"
 
@@ -428,28 +435,2423 @@ test_custom_calloc(void)
     PASS();
 }
 
-SUITE(suite_compound_literals)
+TEST
+test_chain_writev(void)
 {
-    RUN_TEST(test_init_compound_literals);
-    RUN_TEST(test_init_bytemap);
-    RUN_TEST(test_different_types);
-    RUN_TEST(test_large_array);
-    RUN_TEST(test_deep_nested_arrays);
-    RUN_TEST(test_shallow_mida_deep_nesting);
+    char *hello = test_string("Hello");
+    char *comma = test_string(", ");
+    char *world = test_string("World");
+    char *bang = test_string("!");
+    struct mida_chain chain;
+    char buf[32] = { 0 };
+    int fds[2];
+
+    ASSERT_EQ(0, pipe(fds));
+
+    mida_chain_init(&chain);
+    ASSERT_EQ(0, mida_chain_append(&chain, world, MIDA(MD, world)->length));
+    ASSERT_EQ(0, mida_chain_prepend(&chain, comma, MIDA(MD, comma)->length));
+    ASSERT_EQ(0, mida_chain_prepend(&chain, hello, MIDA(MD, hello)->length));
+    ASSERT_EQ(0, mida_chain_append(&chain, bang, MIDA(MD, bang)->length));
+    ASSERT_EQ(4, chain.count);
+    ASSERT_EQ(13, chain.length);
+
+    ASSERT_EQ(13, mida_chain_writev(&chain, fds[1]));
+    ASSERT_EQ(0, chain.length);
+    ASSERT_EQ(13, read(fds[0], buf, sizeof(buf)));
+    ASSERT_STR_EQ("Hello, World!", buf);
+
+    mida_chain_cleanup(&chain);
+    close(fds[0]);
+    close(fds[1]);
+    PASS();
 }
 
-SUITE(suite_stdlib)
+TEST
+test_chain_consume(void)
 {
-    RUN_TEST(test_mida_malloc);
-    RUN_TEST(test_mida_calloc);
-    RUN_TEST(test_mida_realloc);
-    RUN_TEST(test_mida_realloc_null);
+    int *segments[64];
+    struct mida_chain chain;
+    int iovcnt;
+
+    mida_chain_init(&chain);
+    for (size_t i = 0; i < 64; i++) {
+        segments[i] = test_malloc(sizeof(int), 2);
+        if (i % 2)
+            ASSERT_EQ(0, mida_chain_append(&chain, segments[i],
+                                           MIDA(MD, segments[i])->size));
+        else
+            ASSERT_EQ(0, mida_chain_prepend(&chain, segments[i],
+                                            MIDA(MD, segments[i])->size));
+    }
+    ASSERT_EQ(64 * 2 * sizeof(int), chain.length);
+    ASSERT_EQ(segments[62], mida_chain_iov(&chain, &iovcnt)[0].iov_base);
+    ASSERT_EQ(64, iovcnt);
+
+    mida_chain_consume(&chain, 3 * sizeof(int));
+    ASSERT_EQ(63, chain.count);
+    ASSERT_EQ(segments[60] + 1, mida_chain_iov(&chain, &iovcnt)[0].iov_base);
+    ASSERT_EQ(sizeof(int), mida_chain_iov(&chain, &iovcnt)[0].iov_len);
+
+    mida_chain_consume(&chain, chain.length);
+    ASSERT_EQ(0, chain.count);
+    ASSERT_EQ(0, chain.length);
+
+    mida_chain_cleanup(&chain);
+    for (size_t i = 0; i < 64; i++) {
+        mida_free(MD, segments[i]);
+    }
+    PASS();
 }
 
-SUITE(suite_custom_metadata)
+// A layer only gets the data pointer, and finds the lengths through it
+static char *
+_pkb_add_header(char *data, const char *header)
 {
-    RUN_TEST(test_custom_metadata);
-    RUN_TEST(test_custom_calloc);
+    const size_t size = strlen(header);
+
+    data = mida_push(data, size);
+    if (data) memcpy(data, header, size);
+    return data;
+}
+
+TEST
+test_pkb_layers(void)
+{
+    char *data = mida_pkb_malloc(64, 16), *tail;
+
+    ASSERT_EQ(16, mida_headroom(data));
+    ASSERT_EQ(48, mida_tailroom(data));
+
+    tail = mida_put(data, 7);
+    ASSERT_EQ(data, tail);
+    memcpy(tail, "payload", 7);
+    ASSERT_EQ(7, MIDA(struct mida_pkb, data)->length);
+
+    data = _pkb_add_header(data, "TCP:");
+    ASSERT_EQ(11, MIDA(struct mida_pkb, data)->length);
+    data = _pkb_add_header(data, "IP:");
+    ASSERT_EQ(9, mida_headroom(data));
+    ASSERT_EQ(14, MIDA(struct mida_pkb, data)->length);
+    ASSERT_MEM_EQ("IP:TCP:payload", data, 14);
+    MIDA(struct mida_pkb, data)->flags = 42;
+
+    ASSERT_EQ(NULL, mida_push(data, 10));
+    ASSERT_EQ(NULL, mida_put(data, 42));
+
+    // The payload stays in place while the container follows the window
+    data = mida_pull(data, 3);
+    ASSERT_MEM_EQ("TCP:payload", data, 11);
+    data = mida_pull(data, 4);
+    ASSERT_EQ(tail, data);
+    ASSERT_MEM_EQ("payload", data, 7);
+    ASSERT_EQ(7, MIDA(struct mida_pkb, data)->length);
+    ASSERT_EQ(42, MIDA(struct mida_pkb, data)->flags);
+    ASSERT_EQ(NULL, mida_pull(data, 8));
+
+    mida_trim(data, 3);
+    ASSERT_EQ(3, MIDA(struct mida_pkb, data)->length);
+    ASSERT_EQ(16, mida_headroom(data));
+    ASSERT_EQ(45, mida_tailroom(data));
+
+    // The whole headroom can be used, pushing the container to the start
+    data = mida_push(data, 16);
+    ASSERT(data != NULL);
+    ASSERT_EQ(0, mida_headroom(data));
+    ASSERT_EQ(19, MIDA(struct mida_pkb, data)->length);
+    ASSERT_MEM_EQ("pay", data + 16, 3);
+
+    mida_pkb_free(data);
+    mida_pkb_free(NULL);
+    PASS();
+}
+
+TEST
+test_pkb_reserve(void)
+{
+    char *data = mida_pkb_malloc(32, 0);
+
+    data = mida_pkb_reserve(data, 8);
+    ASSERT(data != NULL);
+    ASSERT_EQ(8, mida_headroom(data));
+    ASSERT_EQ(NULL, mida_pkb_reserve(data, 25));
+    ASSERT(mida_put(data, 1) != NULL);
+    ASSERT_EQ(NULL, mida_pkb_reserve(data, 1));
+    ASSERT_EQ(NULL, mida_pkb_malloc(8, 9));
+
+    mida_pkb_free(data);
+    PASS();
+}
+
+struct queue_worker {
+    struct mida_mpmc *q;
+    size_t start, count, sum;
+};
+
+static void *
+_queue_producer(void *arg)
+{
+    struct queue_worker *w = arg;
+
+    for (size_t i = w->start; i < w->start + w->count; i++) {
+        int *item = test_malloc(sizeof(int), 1);
+        *item = (int)i;
+        while (mida_mpmc_push(w->q, item) != 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *
+_queue_consumer(void *arg)
+{
+    struct queue_worker *w = arg;
+
+    for (size_t i = 0; i < w->count; i++) {
+        int *item;
+        while (!(item = mida_mpmc_pop(w->q)))
+            sched_yield();
+        w->sum += (size_t)*item;
+        mida_free(MD, item);
+    }
+    return NULL;
+}
+
+TEST
+test_mpmc_threads(void)
+{
+    struct mida_mpmc q;
+    struct queue_worker workers[4];
+    pthread_t threads[4];
+    size_t sum = 0;
+
+    ASSERT_EQ(0, mida_mpmc_init(&q, 100));
+    ASSERT_EQ(127, q.mask);
+    for (size_t i = 0; i < 4; i++) {
+        workers[i].q = &q;
+        workers[i].start = (i / 2) * 10000;
+        workers[i].count = 10000;
+        workers[i].sum = 0;
+        pthread_create(&threads[i], NULL,
+                       i % 2 ? _queue_consumer : _queue_producer,
+                       &workers[i]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        sum += workers[i].sum;
+    }
+    ASSERT_EQ(19999 * 20000 / 2, sum);
+    ASSERT_EQ(NULL, mida_mpmc_pop(&q));
+
+    mida_mpmc_cleanup(&q);
+    PASS();
+}
+
+TEST
+test_spsc_bounds(void)
+{
+    struct mida_spsc q;
+    int items[4];
+
+    ASSERT_EQ(0, mida_spsc_init(&q, 4));
+    ASSERT_EQ(NULL, mida_spsc_pop(&q));
+    for (size_t i = 0; i < 4; i++) {
+        ASSERT_EQ(0, mida_spsc_push(&q, &items[i]));
+    }
+    ASSERT_EQ(-1, mida_spsc_push(&q, &items[0]));
+    ASSERT_EQ(&items[0], mida_spsc_pop(&q));
+    ASSERT_EQ(0, mida_spsc_push(&q, &items[0]));
+    for (size_t i = 1; i < 4; i++) {
+        ASSERT_EQ(&items[i], mida_spsc_pop(&q));
+    }
+    ASSERT_EQ(&items[0], mida_spsc_pop(&q));
+    ASSERT_EQ(NULL, mida_spsc_pop(&q));
+
+    mida_spsc_cleanup(&q);
+    PASS();
+}
+
+TEST
+test_mpsc_intrusive(void)
+{
+    struct job_metadata {
+        struct mida_qlink link;
+        int id;
+    };
+    struct mida_mpsc q;
+    int *jobs[3];
+
+    mida_mpsc_init(&q);
+    ASSERT_EQ(NULL, mida_mpsc_pop(&q, struct job_metadata, link));
+    for (int i = 0; i < 3; i++) {
+        jobs[i] = mida_malloc(struct job_metadata, sizeof(int), 1);
+        MIDA(struct job_metadata, jobs[i])->id = i;
+        mida_mpsc_push(&q, struct job_metadata, link, jobs[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        int *job = mida_mpsc_pop(&q, struct job_metadata, link);
+        ASSERT_EQ(jobs[i], job);
+        ASSERT_EQ(i, MIDA(struct job_metadata, job)->id);
+        mida_free(struct job_metadata, job);
+    }
+    ASSERT_EQ(NULL, mida_mpsc_pop(&q, struct job_metadata, link));
+    PASS();
+}
+
+TEST
+test_pool_recycle(void)
+{
+    struct mida_pool pool;
+    char *buf, *again;
+
+    mida_pool_init(&pool, 0);
+    buf = mida_pool_malloc(&pool, MD, 5000);
+    ASSERT(buf != NULL);
+    ASSERT_EQ(8192, mida_pool_capacity(MD, buf));
+    ASSERT_EQ(0, MIDA(MD, buf)->length);
+    MIDA(MD, buf)->length = 5000;
+    memset(buf, 'x', 8192);
+    mida_pool_free(&pool, MD, buf);
+
+    again = mida_pool_malloc(&pool, MD, 8000);
+    ASSERT_EQ(buf, again);
+    ASSERT_EQ(0, MIDA(MD, again)->length);
+    ASSERT_EQ(NULL, mida_pool_malloc(&pool, MD, (1 << 20) + 1));
+    mida_pool_free(&pool, MD, again);
+
+    mida_pool_cleanup(&pool);
+    PASS();
+}
+
+TEST
+test_pool_limit_trim(void)
+{
+    struct mida_pool pool;
+    char *bufs[3];
+
+    mida_pool_init(&pool, 2 * (1 << 16) + 2 * 256);
+    ASSERT_EQ(0, mida_pool_prefill(&pool, MD, 1 << 16, 2));
+    ASSERT_EQ(-1, mida_pool_prefill(&pool, MD, 1 << 16, 1));
+    bufs[0] = mida_pool_malloc(&pool, MD, 1 << 16);
+    bufs[1] = mida_pool_malloc(&pool, MD, 1 << 16);
+    ASSERT(bufs[0] != NULL && bufs[1] != NULL);
+    ASSERT_EQ(NULL, mida_pool_malloc(&pool, MD, 4096));
+    mida_pool_free(&pool, MD, bufs[0]);
+    mida_pool_free(&pool, MD, bufs[1]);
+
+#ifdef MADV_FREE
+    ASSERT(mida_pool_trim(&pool) > 0);
+    ASSERT_EQ(0, mida_pool_trim(&pool));
+#endif
+    bufs[2] = mida_pool_malloc(&pool, MD, 1 << 16);
+    ASSERT(bufs[2] == bufs[0] || bufs[2] == bufs[1]);
+    memset(bufs[2], 0, 1 << 16);
+    mida_pool_free(&pool, MD, bufs[2]);
+
+    mida_pool_cleanup(&pool);
+    PASS();
+}
+
+struct pool_big_md {
+    size_t length;
+    char tag[200];
+};
+
+TEST
+test_pool_containers(void)
+{
+    struct mida_pool pool;
+    char *small, *big, *kept;
+
+    mida_pool_init(&pool, 0);
+    small = mida_pool_malloc(&pool, MD, 4096);
+    mida_pool_free(&pool, MD, small);
+
+    // Not recycled for a larger container, which would shrink the data
+    big = mida_pool_malloc(&pool, struct pool_big_md, 4096);
+    ASSERT(big != NULL && big != small);
+    memset(big, 'x', mida_pool_capacity(struct pool_big_md, big));
+    ASSERT_EQ(small, mida_pool_malloc(&pool, MD, 4096));
+    mida_pool_free(&pool, struct pool_big_md, big);
+    ASSERT_EQ(big, mida_pool_malloc(&pool, struct pool_big_md, 4096));
+
+    // Idle buffers of several container sizes, returned interleaved
+    {
+        char *smalls[3], *bigs[2], *got;
+
+        for (int i = 0; i < 3; i++)
+            smalls[i] = mida_pool_malloc(&pool, MD, 4096);
+        for (int i = 0; i < 2; i++)
+            bigs[i] = mida_pool_malloc(&pool, struct pool_big_md, 4096);
+        mida_pool_free(&pool, MD, smalls[0]);
+        mida_pool_free(&pool, struct pool_big_md, bigs[0]);
+        mida_pool_free(&pool, MD, smalls[1]);
+        mida_pool_free(&pool, struct pool_big_md, bigs[1]);
+        mida_pool_free(&pool, MD, smalls[2]);
+        for (int i = 3; i-- > 0;) {
+            got = mida_pool_malloc(&pool, MD, 4096);
+            ASSERT_EQ(smalls[i], got);
+        }
+        for (int i = 2; i-- > 0;) {
+            got = mida_pool_malloc(&pool, struct pool_big_md, 4096);
+            ASSERT_EQ(bigs[i], got);
+        }
+        for (int i = 0; i < 3; i++)
+            mida_pool_free(&pool, MD, smalls[i]);
+        for (int i = 0; i < 2; i++)
+            mida_pool_free(&pool, struct pool_big_md, bigs[i]);
+    }
+
+    // Buffers in use stay accounted for across a cleanup
+    kept = big;
+    mida_pool_free(&pool, MD, small);
+    mida_pool_cleanup(&pool);
+    ASSERT(pool.held >= sizeof(struct pool_big_md) + 4096);
+    mida_pool_free(&pool, struct pool_big_md, kept);
+    mida_pool_cleanup(&pool);
+    ASSERT_EQ(0, pool.held);
+    PASS();
+}
+
+static void *
+_defer_worker(void *arg)
+{
+    for (int i = 0; i < 100; i++) {
+        int *array = test_malloc(sizeof(int), 16);
+        mida_free_deferred(MD, array);
+    }
+    return arg;
+}
+
+TEST
+test_free_deferred(void)
+{
+    pthread_t threads[3];
+
+    mida_reclaim();
+    for (size_t i = 0; i < 3; i++) {
+        pthread_create(&threads[i], NULL, _defer_worker, NULL);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    _defer_worker(NULL);
+    ASSERT_EQ(400, mida_reclaim());
+    ASSERT_EQ(0, mida_reclaim());
+    PASS();
+}
+
+TEST
+test_reclaimer_thread(void)
+{
+    ASSERT_EQ(0, mida_reclaimer_start(1));
+    ASSERT_EQ(-1, mida_reclaimer_start(1));
+    _defer_worker(NULL);
+    mida_reclaimer_stop();
+    ASSERT_EQ(0, mida_reclaim());
+    mida_reclaimer_stop();
+    PASS();
+}
+
+struct epoch_shared {
+    int *current;
+    int stop;
+    size_t torn;
+};
+
+static void *
+_epoch_reader(void *arg)
+{
+    struct epoch_shared *shared = arg;
+
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE)) {
+        mida_epoch_enter();
+        int *array = mida_epoch_load(shared->current);
+        for (size_t i = 1; i < MIDA(MD, array)->length; i++) {
+            if (array[i] != array[0])
+                __atomic_fetch_add(&shared->torn, 1, __ATOMIC_RELAXED);
+        }
+        mida_epoch_exit();
+    }
+    return NULL;
+}
+
+TEST
+test_epoch_retire(void)
+{
+    struct epoch_shared shared = { NULL, 0, 0 };
+    pthread_t readers[2];
+
+    shared.current = test_calloc(sizeof(int), 8);
+    for (size_t i = 0; i < 2; i++) {
+        pthread_create(&readers[i], NULL, _epoch_reader, &shared);
+    }
+    for (int version = 1; version <= 1000; version++) {
+        int *array = test_malloc(sizeof(int), 8);
+        for (size_t i = 0; i < 8; i++) {
+            array[i] = version;
+        }
+        mida_retire(MD, mida_epoch_publish(shared.current, array));
+    }
+    __atomic_store_n(&shared.stop, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    mida_epoch_synchronize();
+    ASSERT_EQ(0, shared.torn);
+    ASSERT_EQ(1000, shared.current[7]);
+
+    mida_free(MD, shared.current);
+    PASS();
+}
+
+TEST
+test_epoch_synchronize(void)
+{
+    mida_epoch_synchronize();
+    mida_epoch_enter();
+    mida_epoch_enter();
+    mida_retire(MD, test_malloc(sizeof(int), 1));
+    mida_epoch_exit();
+    ASSERT_EQ(0, mida_epoch_collect());
+    mida_epoch_exit();
+    ASSERT_EQ(1, mida_epoch_synchronize());
+    ASSERT_EQ(0, mida_epoch_synchronize());
+    PASS();
+}
+
+typedef struct seq_metadata {
+    struct mida_seqlock lock;
+    size_t version;
+    char author[32];
+    size_t checksum;
+} SeqMD;
+
+struct seq_shared {
+    int *records;
+    int stop;
+    size_t reads;
+    size_t torn;
+};
+
+static void *
+_seq_reader(void *arg)
+{
+    struct seq_shared *shared = arg;
+
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE)) {
+        SeqMD copy;
+        mida_meta_read(SeqMD, shared->records, &copy);
+        if (copy.checksum != copy.version * 3
+            || (size_t)(copy.author[0] - 'a') != copy.version % 26)
+            shared->torn++;
+        shared->reads++;
+        sched_yield();
+    }
+    return NULL;
+}
+
+TEST
+test_meta_seqlock(void)
+{
+    struct seq_shared shared = { NULL, 0, 0, 0 };
+    pthread_t reader;
+
+    shared.records = mida_calloc(SeqMD, sizeof(int), 4);
+    memset(MIDA(SeqMD, shared.records)->author, 'a', 31);
+    pthread_create(&reader, NULL, _seq_reader, &shared);
+    for (size_t version = 1; version <= 20000; version++) {
+        SeqMD *meta = MIDA(SeqMD, shared.records);
+        mida_meta_write_begin(SeqMD, shared.records);
+        meta->version = version;
+        memset(meta->author, 'a' + (int)(version % 26), 31);
+        meta->checksum = version * 3;
+        mida_meta_write_end(SeqMD, shared.records);
+    }
+    __atomic_store_n(&shared.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(reader, NULL);
+
+    SeqMD copy;
+    mida_meta_read(SeqMD, shared.records, &copy);
+    ASSERT_EQ(0, shared.torn);
+    ASSERT_EQ(20000, copy.version);
+    ASSERT_EQ(40000, copy.lock.seq);
+
+    mida_free(SeqMD, shared.records);
+    PASS();
+}
+
+TEST
+test_handle_generations(void)
+{
+    struct mida_pool pool;
+    struct mida_handles table;
+    mida_handle handles[4], reused;
+    int *array, *freed;
+
+    mida_pool_init(&pool, 0);
+    ASSERT_EQ(0, mida_handles_init(&table, 3, &pool));
+    for (size_t i = 0; i < 3; i++) {
+        handles[i] = mida_handle_malloc(&table, MD, sizeof(int), 4);
+        ASSERT(handles[i] != 0);
+        array = mida_handle_get(&table, handles[i]);
+        ASSERT_EQ(0, MIDA(MD, array)->length);
+        MIDA(MD, array)->length = i;
+    }
+    handles[3] = mida_handle_malloc(&table, MD, sizeof(int), 4);
+    ASSERT_EQ(0, handles[3]);
+    ASSERT_EQ(NULL, mida_handle_get(&table, 0));
+
+    freed = mida_handle_get(&table, handles[1]);
+    ASSERT_EQ(1, MIDA(MD, freed)->length);
+    mida_handle_free(&table, MD, handles[1]);
+    ASSERT_EQ(NULL, mida_handle_get(&table, handles[1]));
+    ASSERT_EQ(NULL, mida_handle_release(&table, handles[1]));
+
+    // The slot gets a new generation, the block comes back from the pool
+    reused = mida_handle_malloc(&table, MD, sizeof(int), 4);
+    ASSERT_EQ((uint32_t)handles[1], (uint32_t)reused);
+    ASSERT(reused != handles[1]);
+    ASSERT_EQ(NULL, mida_handle_get(&table, handles[1]));
+    ASSERT_EQ(freed, mida_handle_get(&table, reused));
+    ASSERT_EQ(0, MIDA(MD, freed)->length);
+
+    mida_handle_free(&table, MD, reused);
+    ASSERT_EQ(0, mida_handle_malloc(&table, MD, 1, (1 << 20) + 1));
+    mida_handle_free(&table, MD, handles[0]);
+    array = mida_handle_release(&table, handles[2]);
+    ASSERT_EQ(2, MIDA(MD, array)->length);
+    mida_pool_free(&pool, MD, array);
+
+    mida_handles_cleanup(&table);
+    mida_pool_cleanup(&pool);
+
+    // Without a pool the objects live on the heap
+    ASSERT_EQ(0, mida_handles_init(&table, 1, NULL));
+    handles[0] = mida_handle_malloc(&table, MD, sizeof(int), 4);
+    ASSERT(handles[0] != 0);
+    array = mida_handle_get(&table, handles[0]);
+    ASSERT(array != NULL);
+    MIDA(MD, array)->length = 4;
+    mida_handle_free(&table, MD, handles[0]);
+    ASSERT_EQ(NULL, mida_handle_get(&table, handles[0]));
+    mida_handles_cleanup(&table);
+    PASS();
+}
+
+TEST
+test_soa_columns(void)
+{
+    typedef struct record_metadata {
+        time_t modified;
+        int flags;
+    } RecordMD;
+    enum { MODIFIED, FLAGS };
+    const size_t sizes[] = { MIDA_SOA_FIELD(RecordMD, modified),
+                             MIDA_SOA_FIELD(RecordMD, flags) };
+    struct mida_soa soa;
+    int *records[100];
+
+    ASSERT_EQ(0, mida_soa_init(&soa, sizes, 2));
+    for (size_t i = 0; i < 100; i++) {
+        records[i] = mida_soa_malloc(&soa, sizeof(int), 2);
+        ASSERT_EQ(i, MIDA(struct mida_soa_id, records[i])->id);
+        ASSERT_EQ(0, MIDA_SOA(&soa, int, FLAGS, records[i]));
+        MIDA_SOA(&soa, int, FLAGS, records[i]) = (int)i;
+    }
+    ASSERT_EQ(100, soa.length);
+
+    // Bulk stamp one field across every object
+    time_t *modified = mida_soa_column(&soa, time_t, MODIFIED);
+    for (size_t id = 0; id < soa.length; id++) {
+        modified[id] = 1625000000;
+    }
+    ASSERT_EQ(1625000000, MIDA_SOA(&soa, time_t, MODIFIED, records[42]));
+    ASSERT_EQ(42, MIDA_SOA(&soa, int, FLAGS, records[42]));
+
+    mida_soa_free(&soa, records[42]);
+    records[42] = mida_soa_malloc(&soa, sizeof(int), 2);
+    ASSERT_EQ(42, MIDA(struct mida_soa_id, records[42])->id);
+    ASSERT_EQ(0, MIDA_SOA(&soa, int, FLAGS, records[42]));
+    ASSERT_EQ(100, soa.length);
+
+    for (size_t i = 0; i < 100; i++) {
+        mida_soa_free(&soa, records[i]);
+    }
+    mida_soa_cleanup(&soa);
+    PASS();
+}
+
+TEST
+test_sidetable_foreign(void)
+{
+    static int foreign[3][16];
+    MD metas[3] = { { sizeof(foreign[0]), 16 },
+                    { sizeof(foreign[1]), 8 },
+                    { sizeof(foreign[2]), 4 } };
+
+    for (size_t i = 0; i < 3; i++) {
+        ASSERT_EQ(NULL, mida_lookup(foreign[i]));
+        ASSERT_EQ(0, mida_attach(foreign[i], &metas[i]));
+    }
+    ASSERT_EQ(8, MIDA_LOOKUP(MD, foreign[1])->length);
+    ASSERT_EQ(&metas[1], mida_detach(foreign[1]));
+    ASSERT_EQ(NULL, mida_lookup(foreign[1]));
+    ASSERT_EQ(NULL, mida_detach(foreign[1]));
+    ASSERT_EQ(0, mida_attach(foreign[1], &metas[0]));
+    ASSERT_EQ(16, MIDA_LOOKUP(MD, foreign[1])->length);
+
+    for (size_t i = 0; i < 3; i++) {
+        mida_detach(foreign[i]);
+    }
+    PASS();
+}
+
+TEST
+test_sidetable_full(void)
+{
+    struct mida_sidetable table;
+    char buffers[9];
+
+    ASSERT_EQ(0, mida_sidetable_init(&table, 5));
+    ASSERT_EQ(7, table.mask);
+    for (size_t i = 0; i < 8; i++) {
+        ASSERT_EQ(0, mida_sidetable_attach(&table, &buffers[i], &buffers[i]));
+    }
+    ASSERT_EQ(-1, mida_sidetable_attach(&table, &buffers[8], &buffers[8]));
+    ASSERT_EQ(0, mida_sidetable_attach(&table, &buffers[3], &buffers[0]));
+    for (size_t i = 0; i < 8; i++) {
+        ASSERT_EQ(i == 3 ? &buffers[0] : &buffers[i],
+                  mida_sidetable_lookup(&table, &buffers[i]));
+    }
+    ASSERT_EQ(NULL, mida_sidetable_lookup(&table, &buffers[8]));
+
+    // Updating an attached buffer doesn't take the slot of a detached one
+    ASSERT_EQ(&buffers[0], mida_sidetable_detach(&table, &buffers[0]));
+    for (size_t i = 1; i < 8; i++) {
+        ASSERT_EQ(0, mida_sidetable_attach(&table, &buffers[i], &buffers[8]));
+    }
+    ASSERT_EQ(0, mida_sidetable_attach(&table, &buffers[8], &buffers[8]));
+    ASSERT_EQ(-1, mida_sidetable_attach(&table, &buffers[0], &buffers[0]));
+    for (size_t i = 1; i < 9; i++) {
+        ASSERT_EQ(&buffers[8], mida_sidetable_lookup(&table, &buffers[i]));
+    }
+
+    mida_sidetable_cleanup(&table);
+    PASS();
+}
+
+TEST
+test_sidetable_churn(void)
+{
+    const size_t count = 2 * MIDA_SIDETABLE_CAPACITY + 3;
+    char *buffers = malloc(count);
+    MD meta = { 1, 1 };
+
+    // Detached slots are reused, so distinct buffers never fill the table
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(0, mida_attach(&buffers[i], &meta));
+        ASSERT_EQ(&meta, mida_lookup(&buffers[i]));
+        if (i > 0) {
+            ASSERT_EQ(&meta, mida_detach(&buffers[i - 1]));
+            ASSERT_EQ(NULL, mida_lookup(&buffers[i - 1]));
+        }
+    }
+    ASSERT_EQ(&meta, mida_detach(&buffers[count - 1]));
+    for (size_t i = 0; i < count; i++)
+        ASSERT_EQ(NULL, mida_lookup(&buffers[i]));
+    free(buffers);
+    PASS();
+}
+
+TEST
+test_layers_stack(void)
+{
+    struct net_meta {
+        int protocol;
+    };
+    struct cache_meta {
+        size_t hits;
+        double score;
+    };
+    char *buf = mida_layered_malloc(48, sizeof(char), 6);
+    int net, cache, md;
+
+    memcpy(buf, "frame", 6);
+    ASSERT_EQ(0, net = mida_layer_push(buf, struct net_meta));
+    MIDA_LAYER(struct net_meta, buf, net)->protocol = 6;
+    ASSERT_EQ(1, cache = mida_layer_push(buf, struct cache_meta));
+    MIDA_LAYER(struct cache_meta, buf, cache)->hits = 3;
+    ASSERT_EQ(2, md = mida_layer_push(buf, MD));
+    MIDA_LAYER(MD, buf, md)->length = 5;
+    ASSERT_EQ(-1, mida_layer_push(buf, struct cache_meta));
+
+    ASSERT_EQ(6, MIDA_LAYER(struct net_meta, buf, net)->protocol);
+    ASSERT_EQ(3, MIDA_LAYER(struct cache_meta, buf, cache)->hits);
+    ASSERT_EQ(5, MIDA_LAYER(MD, buf, md)->length);
+    ASSERT_EQ(3, MIDA(struct mida_layers, buf)->count);
+    ASSERT_STR_EQ("frame", buf);
+
+    mida_layer_pop(buf);
+    ASSERT_EQ(2, MIDA(struct mida_layers, buf)->count);
+    ASSERT_EQ(2, mida_layer_push(buf, struct net_meta));
+    ASSERT_EQ(0, MIDA_LAYER(struct net_meta, buf, 2)->protocol);
+
+    mida_layered_free(buf);
+    PASS();
+}
+
+struct deep_doc {
+    char *title;
+    int *pages;
+    struct deep_doc *related;
+};
+
+static size_t
+_deep_count(const void *base)
+{
+    return MIDA(MD, base)->length;
+}
+
+static const struct mida_type deep_string_type = { sizeof(MD), sizeof(char),
+                                                   _deep_count, NULL, 0 };
+static const struct mida_type deep_pages_type = { sizeof(MD), sizeof(int),
+                                                  _deep_count, NULL, 0 };
+static const struct mida_type deep_doc_type;
+static const struct mida_field deep_doc_fields[] = {
+    MIDA_FIELD(struct deep_doc, title, &deep_string_type),
+    MIDA_FIELD(struct deep_doc, pages, &deep_pages_type),
+    MIDA_FIELD(struct deep_doc, related, &deep_doc_type),
+};
+static const struct mida_type deep_doc_type = {
+    sizeof(MD), sizeof(struct deep_doc), NULL, deep_doc_fields, 3
+};
+
+static struct deep_doc *
+_deep_doc(const char *title, int pages, struct deep_doc *related)
+{
+    struct deep_doc *doc = test_malloc(sizeof(struct deep_doc), 1);
+
+    doc->title = test_malloc(sizeof(char), strlen(title) + 1);
+    strcpy(doc->title, title);
+    doc->pages = NULL;
+    if (pages) {
+        doc->pages = test_malloc(sizeof(int), (size_t)pages);
+        for (int i = 0; i < pages; i++) {
+            doc->pages[i] = i + 1;
+        }
+    }
+    doc->related = related;
+    return doc;
+}
+
+TEST
+test_clone_deep(void)
+{
+    struct deep_doc *doc =
+        _deep_doc("Annual Report", 5, _deep_doc("Appendix", 0, NULL));
+    struct deep_doc *clone = mida_clone_deep(&deep_doc_type, doc);
+
+    ASSERT(clone != NULL && clone != doc);
+    ASSERT(clone->title != doc->title);
+    ASSERT_STR_EQ("Annual Report", clone->title);
+    ASSERT_EQ(14, MIDA(MD, clone->title)->length);
+    ASSERT_EQ(5, MIDA(MD, clone->pages)->length);
+    ASSERT_EQ(5, clone->pages[4]);
+    ASSERT(clone->related != doc->related);
+    ASSERT_STR_EQ("Appendix", clone->related->title);
+    ASSERT_EQ(NULL, clone->related->pages);
+    ASSERT_EQ(NULL, clone->related->related);
+
+    // Objects are laid out contiguously, in depth-first order
+    ASSERT((char *)clone->title > (char *)clone);
+    ASSERT((char *)clone->related->title > (char *)clone->related);
+    ASSERT((char *)clone->related > (char *)clone->pages);
+
+    mida_free_deep(&deep_doc_type, doc);
+    mida_free(MD, clone);
+    PASS();
+}
+
+struct near_node {
+    struct near_node *left, *right;
+    int value;
+};
+
+TEST
+test_malloc_near(void)
+{
+    struct near_node *root =
+        mida_malloc_near(MD, NULL, MD, sizeof *root, 1);
+    struct near_node *left =
+        mida_malloc_near(MD, root, MD, sizeof *left, 1);
+    int *values = mida_malloc_near(MD, left, MD, sizeof(int), 4);
+
+    ASSERT(root != NULL && left != NULL && values != NULL);
+    MIDA(MD, root)->length = 1;
+    MIDA(MD, values)->length = 4;
+    root->left = left;
+    left->value = 42;
+    for (int i = 0; i < 4; i++) {
+        values[i] = i;
+    }
+
+    // Children are placed right after their parent
+    ASSERT((char *)left > (char *)root);
+    ASSERT((char *)left - (char *)root < 2 * MIDA_CACHELINE);
+    ASSERT((char *)values - (char *)left < 2 * MIDA_CACHELINE);
+    ASSERT_EQ(0, (uintptr_t)left % 16);
+    ASSERT_EQ(1, MIDA(MD, root)->length);
+    ASSERT_EQ(4, MIDA(MD, values)->length);
+    ASSERT_EQ(42, root->left->value);
+
+    mida_free_near(MD, values);
+    mida_free_near(MD, root);
+    mida_free_near(MD, left);
+    mida_free_near(MD, NULL);
+    PASS();
+}
+
+TEST
+test_malloc_near_overflow(void)
+{
+    struct near_node *root =
+        mida_malloc_near(MD, NULL, MD, sizeof *root, 1);
+    struct near_node *parent = root;
+    char *big;
+    int count = 0;
+
+    ASSERT(root != NULL);
+    root->value = 0;
+    // Fill several chunks, each child hinted next to the previous one
+    for (int i = 1; i < 1000; i++) {
+        struct near_node *child =
+            mida_malloc_near(MD, parent, MD, sizeof *child, 1);
+
+        ASSERT(child != NULL);
+        child->left = parent;
+        child->value = i;
+        parent = child;
+    }
+    // Larger than a chunk, gets a chunk of its own
+    big = mida_malloc_near(MD, parent, MD, 1, 4 * MIDA_NEAR_CHUNK);
+    ASSERT(big != NULL);
+    memset(big, 'x', 4 * MIDA_NEAR_CHUNK);
+
+    while (parent != root) {
+        struct near_node *next = parent->left;
+
+        ASSERT_EQ(999 - count, parent->value);
+        mida_free_near(MD, parent);
+        parent = next;
+        ++count;
+    }
+    ASSERT_EQ(999, count);
+    mida_free_near(MD, big);
+    mida_free_near(MD, root);
+    PASS();
+}
+
+struct walk_node {
+    int value;
+    struct walk_node *next;
+};
+
+TEST
+test_prefetch(void)
+{
+    int *array = test_malloc(sizeof(int), 100);
+
+    ASSERT(array != NULL);
+    // Only hints, must not fault even past the end of small objects
+    mida_prefetch(MD, array);
+    mida_prefetch_range(array, 100 * sizeof(int));
+    mida_prefetch_range(array, 1);
+    mida_free(MD, array);
+    PASS();
+}
+
+TEST
+test_walk(void)
+{
+    struct walk_node *head = NULL;
+    struct mida_walk walk;
+    struct walk_node *node;
+    int expected = 0;
+
+    for (int i = 99; i >= 0; i--) {
+        node = mida_malloc(MD, sizeof *node, 1);
+        ASSERT(node != NULL);
+        MIDA(MD, node)->length = (size_t)i;
+        node->value = i;
+        node->next = head;
+        head = node;
+    }
+
+    mida_walk_init(&walk, MD, head, struct walk_node, next, 8);
+    while ((node = mida_walk_next(&walk)) != NULL) {
+        ASSERT_EQ(expected, node->value);
+        ASSERT_EQ((size_t)expected, MIDA(MD, node)->length);
+        ++expected;
+    }
+    ASSERT_EQ(100, expected);
+    ASSERT_EQ(NULL, mida_walk_next(&walk));
+
+    // Depth larger than the chain, and larger than the window
+    node = head;
+    for (int i = 0; i < 90; i++) {
+        node = node->next;
+    }
+    expected = 90;
+    mida_walk_init(&walk, MD, node, struct walk_node, next, 1000);
+    while ((node = mida_walk_next(&walk)) != NULL) {
+        ASSERT_EQ(expected, node->value);
+        ++expected;
+    }
+    ASSERT_EQ(100, expected);
+
+    mida_walk_init(&walk, MD, NULL, struct walk_node, next, 4);
+    ASSERT_EQ(NULL, mida_walk_next(&walk));
+
+    while (head) {
+        node = head->next;
+        mida_free(MD, head);
+        head = node;
+    }
+    PASS();
+}
+
+TEST
+test_compact_string(void)
+{
+    char *small = mida_compact_string("hello", 5);
+    char *exact = mida_compact_string("0123456789012345678901234567890", 31);
+
+    ASSERT(small != NULL && exact != NULL);
+    ASSERT_STR_EQ("hello", small);
+    ASSERT_EQ(5, mida_compact_length(small));
+    ASSERT_EQ(0, mida_compact_flags(small));
+    // A single header byte below 32
+    ASSERT_EQ(0, ((unsigned char *)small)[-1] & 0x80);
+    ASSERT_EQ(31, mida_compact_length(exact));
+    ASSERT_EQ(31, strlen(exact));
+
+    mida_compact_set_flags(small, 3);
+    ASSERT_EQ(3, mida_compact_flags(small));
+    ASSERT_EQ(5, mida_compact_length(small));
+    mida_compact_set_flags(small, 1);
+    ASSERT_EQ(1, mida_compact_flags(small));
+
+    mida_compact_free(small);
+    mida_compact_free(exact);
+    mida_compact_free(NULL);
+    PASS();
+}
+
+TEST
+test_compact_malloc(void)
+{
+    const size_t lengths[] = { 0, 31, 32, 4095, 4096, 1 << 20 };
+
+    for (size_t i = 0; i < sizeof lengths / sizeof *lengths; i++) {
+        unsigned char *data = mida_compact_malloc(lengths[i], 2);
+
+        ASSERT(data != NULL);
+        memset(data, 0xff, lengths[i]);
+        ASSERT_EQ(lengths[i], mida_compact_length(data));
+        ASSERT_EQ(2, mida_compact_flags(data));
+        mida_compact_free(data);
+    }
+    // Two header bytes below 4096
+    {
+        unsigned char *data = mida_compact_malloc(4095, 0);
+        ASSERT(data != NULL);
+        ASSERT(data[-1] & 0x80);
+        ASSERT_EQ(0, data[-2] & 0x80);
+        mida_compact_free(data);
+    }
+    ASSERT_EQ(NULL, mida_compact_malloc((size_t)-1, 0));
+    PASS();
+}
+
+TEST
+test_str_append(void)
+{
+    char *str = mida_str_new("Hello");
+    char *empty = mida_str_new(NULL);
+    char *built = NULL;
+    size_t capacity;
+
+    ASSERT(str != NULL && empty != NULL);
+    ASSERT_STR_EQ("", empty);
+    ASSERT_EQ(0, MIDA(struct mida_str, empty)->length);
+    ASSERT_STR_EQ("Hello", str);
+    ASSERT_EQ(5, MIDA(struct mida_str, str)->length);
+
+    ASSERT_EQ(0, mida_str_append(&str, ", World"));
+    ASSERT_EQ(0, mida_str_appendn(&str, "!!!", 1));
+    ASSERT_STR_EQ("Hello, World!", str);
+    ASSERT_EQ(13, MIDA(struct mida_str, str)->length);
+
+    // Appending to NULL creates the string
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(0, mida_str_append(&built, "ab"));
+    }
+    ASSERT_EQ(2000, MIDA(struct mida_str, built)->length);
+    ASSERT_EQ(2000, strlen(built));
+    ASSERT(MIDA(struct mida_str, built)->capacity < 4000);
+
+    ASSERT_EQ(0, mida_str_reserve(&built, 5000));
+    capacity = MIDA(struct mida_str, built)->capacity;
+    ASSERT(capacity >= 7000);
+    mida_str_clear(built);
+    ASSERT_STR_EQ("", built);
+    ASSERT_EQ(0, MIDA(struct mida_str, built)->length);
+    ASSERT_EQ(capacity, MIDA(struct mida_str, built)->capacity);
+
+    mida_str_free(str);
+    mida_str_free(empty);
+    mida_str_free(built);
+    mida_str_free(NULL);
+    PASS();
+}
+
+TEST
+test_str_append_self(void)
+{
+    char *str = mida_str_new("abcdefghijklmn");
+
+    ASSERT(str != NULL);
+    // Both appends outgrow the capacity, moving the source
+    ASSERT_EQ(0, mida_str_append(&str, str));
+    ASSERT_STR_EQ("abcdefghijklmnabcdefghijklmn", str);
+    ASSERT_EQ(0, mida_str_appendn(&str, str + 14, 14));
+    ASSERT_STR_EQ("abcdefghijklmnabcdefghijklmnabcdefghijklmn", str);
+    ASSERT_EQ(42, MIDA(struct mida_str, str)->length);
+    mida_str_free(str);
+
+    // Formatted from itself, with room left so the first pass fits in place
+    str = mida_str_new("abc");
+    ASSERT_EQ(0, mida_str_reserve(&str, 100));
+    ASSERT_EQ(0, mida_str_appendf(&str, "%s|%s", str, str));
+    ASSERT_STR_EQ("abcabc|abc", str);
+    ASSERT_EQ(0, mida_str_appendf(&str, "%s%s%s", str, str, str));
+    ASSERT_EQ(40, MIDA(struct mida_str, str)->length);
+    ASSERT_EQ(0, strncmp(str + 10, "abcabc|abc", 10));
+    // Longer than the scratch buffer
+    ASSERT_EQ(0, mida_str_appendf(&str, "%s%s%s%s%s%s%s%s", str, str, str,
+                                  str, str, str, str, str));
+    ASSERT_EQ(360, MIDA(struct mida_str, str)->length);
+    ASSERT_EQ(0, strncmp(str + 320, "abcabc|abc", 10));
+
+    mida_str_free(str);
+    PASS();
+}
+
+TEST
+test_str_appendf(void)
+{
+    char *str = NULL;
+    char expected[64];
+
+    ASSERT_EQ(0, mida_str_appendf(&str, "%d-%s", 42, "answer"));
+    ASSERT_STR_EQ("42-answer", str);
+    ASSERT_EQ(9, MIDA(struct mida_str, str)->length);
+
+    // Fits in the spare capacity
+    ASSERT_EQ(0, mida_str_appendf(&str, "%c", '!'));
+    ASSERT_STR_EQ("42-answer!", str);
+
+    // Needs to grow
+    ASSERT_EQ(0, mida_str_appendf(&str, " %s %s", "0123456789abcdef",
+                                  "0123456789abcdef"));
+    snprintf(expected, sizeof expected, "42-answer! %s %s",
+             "0123456789abcdef", "0123456789abcdef");
+    ASSERT_STR_EQ(expected, str);
+    ASSERT_EQ(strlen(expected), MIDA(struct mida_str, str)->length);
+
+    mida_str_free(str);
+    PASS();
+}
+
+TEST
+test_hash(void)
+{
+    const char *text = "Nobody inspects the spammish repetition";
+
+    // Reference XXH64 values
+    ASSERT_EQ(UINT64_C(0xEF46DB3751D8E999), mida_hash("", 0));
+    ASSERT_EQ(UINT64_C(0xD24EC4F1A98C6E5B), mida_hash("a", 1));
+    ASSERT_EQ(UINT64_C(0x44BC2CF5AD770999), mida_hash("abc", 3));
+    ASSERT_EQ(UINT64_C(0xFBCEA83C8A378BF1), mida_hash(text, strlen(text)));
+    PASS();
+}
+
+TEST
+test_hstr(void)
+{
+    char *a = mida_hstr_new("hello world", 11);
+    char *b = mida_hstr_new("hello world!", 11);
+    char *c = mida_hstr_new("hello", 5);
+
+    ASSERT(a != NULL && b != NULL && c != NULL);
+    ASSERT_STR_EQ("hello world", b);
+    ASSERT_EQ(11, MIDA(struct mida_hstr, a)->length);
+    ASSERT_EQ(mida_hash("hello world", 11), MIDA(struct mida_hstr, a)->hash);
+    ASSERT(mida_hstr_equals(a, b));
+    ASSERT(mida_hstr_equals(a, a));
+    ASSERT_FALSE(mida_hstr_equals(a, c));
+
+    mida_hstr_free(a);
+    mida_hstr_free(b);
+    mida_hstr_free(c);
+    mida_hstr_free(NULL);
+    PASS();
+}
+
+static struct mida_interns intern_pool;
+
+static void *
+_intern_worker(void *arg)
+{
+    const char **out = arg;
+    char key[16];
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof key, "key-%d", i);
+        out[i] = mida_intern(&intern_pool, key, strlen(key));
+    }
+    return NULL;
+}
+
+TEST
+test_intern(void)
+{
+    static const char *interned[4][500];
+    pthread_t threads[4];
+    const char *a, *b, *c;
+
+    mida_interns_init(&intern_pool);
+    a = mida_intern(&intern_pool, "shared", 6);
+    b = mida_intern(&intern_pool, "shared key", 6);
+    c = mida_intern(&intern_pool, "other", 5);
+    ASSERT(a != NULL && c != NULL);
+    ASSERT_EQ(a, b);
+    ASSERT(a != c);
+    ASSERT_STR_EQ("shared", a);
+    ASSERT_EQ(mida_hash("shared", 6), MIDA(struct mida_hstr, a)->hash);
+
+    // Concurrent interning of the same keys gives the same pointers
+    for (int t = 0; t < 4; t++) {
+        pthread_create(&threads[t], NULL, _intern_worker, interned[t]);
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int i = 0; i < 500; i++) {
+        char key[16];
+
+        snprintf(key, sizeof key, "key-%d", i);
+        ASSERT(interned[0][i] != NULL);
+        ASSERT_STR_EQ(key, interned[0][i]);
+        for (int t = 1; t < 4; t++) {
+            ASSERT_EQ(interned[0][i], interned[t][i]);
+        }
+    }
+
+    mida_interns_cleanup(&intern_pool);
+    PASS();
+}
+
+static int
+_sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+// Checks the mida_str_* operations against libc, over lengths covering
+// both the vector loops and their tails
+static enum greatest_test_res
+_str_ops_check(void)
+{
+    unsigned seed = 7;
+
+    for (size_t n = 0; n < 140; n++) {
+        char *a = mida_str_new(NULL), *b, *lower, *found;
+
+        for (size_t i = 0; i < n; i++) {
+            seed = seed * 1103515245 + 12345;
+            mida_str_appendn(&a, &"abAB,;"[(seed >> 16) % 6], 1);
+        }
+        b = mida_str_new(a);
+        ASSERT(mida_str_equals(a, b));
+        ASSERT_EQ(0, mida_str_compare(a, b));
+        if (n) {
+            b[n / 2] = '\x80';
+            ASSERT_FALSE(mida_str_equals(a, b));
+            ASSERT_EQ(_sign(strcmp(a, b)), _sign(mida_str_compare(a, b)));
+            ASSERT_EQ(-1, _sign(mida_str_compare(a, b)));
+            b[n / 2] = a[n / 2];
+        }
+        mida_str_appendn(&b, "x", 1);
+        ASSERT_FALSE(mida_str_equals(a, b));
+        ASSERT_EQ(-1, mida_str_compare(a, b));
+        ASSERT_EQ(1, mida_str_compare(b, a));
+
+        for (size_t m = 1; m < 6 && m <= n; m++) {
+            char needle[8];
+
+            memcpy(needle, a + n - m, m);
+            needle[m] = '\0';
+            found = mida_str_find(a, needle, m);
+            ASSERT_EQ(strstr(a, needle), found);
+        }
+        ASSERT_EQ(NULL, mida_str_find(a, "zz", 2));
+        ASSERT_EQ(a, mida_str_find(a, "", 0));
+        ASSERT_EQ(strpbrk(a, ",;"), mida_str_find_any(a, ",;"));
+        ASSERT_EQ(strpbrk(a, ";"), mida_str_find_any(a, ";"));
+        ASSERT_EQ(strpbrk(a, "0123456789ABCDEFGHIJ"),
+                  mida_str_find_any(a, "0123456789ABCDEFGHIJ"));
+
+        lower = mida_str_new(a);
+        mida_str_to_lower(lower);
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(tolower((unsigned char)a[i]), lower[i]);
+        }
+
+        mida_str_free(a);
+        mida_str_free(b);
+        mida_str_free(lower);
+    }
+    PASS();
+}
+
+TEST
+test_str_ops(void)
+{
+    CHECK_CALL(_str_ops_check());
+#ifdef MIDA_WITH_SSE2
+    // Same again without AVX2
+    {
+        const int avx2 = __mida_avx2;
+
+        __mida_avx2 = 0;
+        CHECK_CALL(_str_ops_check());
+        __mida_avx2 = avx2;
+    }
+#endif
+    PASS();
+}
+
+TEST
+test_str_split(void)
+{
+    char *str = mida_str_new("alpha,beta,,gamma,");
+    char *empty = mida_str_new(NULL);
+    struct mida_slice *slices = mida_str_split(str, ',');
+
+    ASSERT(slices != NULL);
+    ASSERT_EQ(5, MIDA(struct mida_str, slices)->length);
+    ASSERT_EQ(5, slices[0].length);
+    ASSERT_EQ(0, strncmp("alpha", slices[0].data, 5));
+    ASSERT_EQ(4, slices[1].length);
+    ASSERT_EQ(0, strncmp("beta", slices[1].data, 4));
+    ASSERT_EQ(0, slices[2].length);
+    ASSERT_EQ(5, slices[3].length);
+    ASSERT_EQ(0, strncmp("gamma", slices[3].data, 5));
+    ASSERT_EQ(0, slices[4].length);
+    ASSERT_EQ(str + 18, slices[4].data);
+    mida_free(struct mida_str, slices);
+
+    slices = mida_str_split(empty, ',');
+    ASSERT(slices != NULL);
+    ASSERT_EQ(1, MIDA(struct mida_str, slices)->length);
+    ASSERT_EQ(0, slices[0].length);
+    mida_free(struct mida_str, slices);
+
+    mida_str_free(str);
+    mida_str_free(empty);
+    PASS();
+}
+
+struct map_entry_md {
+    struct mida_hnode link;
+    size_t length;
+};
+
+static int
+_map_eq(const void *base, const void *key)
+{
+    return 0 == strcmp(base, key);
+}
+
+TEST
+test_map(void)
+{
+    struct mida_map map;
+    char *names[100];
+    char key[16];
+    size_t count = 0;
+    void *it;
+
+    mida_map_init(&map, struct map_entry_md, link, _map_eq);
+    ASSERT_EQ(NULL, mida_map_find(&map, mida_hash("x", 1), "x"));
+    ASSERT_EQ(NULL, mida_map_next(&map, NULL));
+
+    for (int i = 0; i < 100; i++) {
+        int n = snprintf(key, sizeof key, "name-%d", i);
+
+        names[i] = mida_malloc(struct map_entry_md, 1, (size_t)n + 1);
+        memcpy(names[i], key, (size_t)n + 1);
+        MIDA(struct map_entry_md, names[i])->length = (size_t)n;
+        ASSERT_EQ(0, mida_map_insert(&map, names[i],
+                                     mida_hash(key, (size_t)n)));
+    }
+    ASSERT_EQ(100, map.count);
+    for (int i = 0; i < 100; i++) {
+        int n = snprintf(key, sizeof key, "name-%d", i);
+        char *found = mida_map_find(&map, mida_hash(key, (size_t)n), key);
+
+        ASSERT_EQ(names[i], found);
+        ASSERT_EQ((size_t)n, MIDA(struct map_entry_md, found)->length);
+    }
+    ASSERT_EQ(NULL, mida_map_find(&map, mida_hash("name-x", 6), "name-x"));
+
+    // Same hash, different key
+    ASSERT_EQ(NULL, mida_map_find(&map, mida_hash("name-7", 6), "name-8"));
+
+    ASSERT_EQ(names[7], mida_map_remove(&map, mida_hash("name-7", 6),
+                                         "name-7"));
+    ASSERT_EQ(NULL, mida_map_find(&map, mida_hash("name-7", 6), "name-7"));
+    mida_map_unlink(&map, names[8]);
+    ASSERT_EQ(NULL, mida_map_find(&map, mida_hash("name-8", 6), "name-8"));
+    ASSERT_EQ(98, map.count);
+    mida_free(struct map_entry_md, names[7]);
+    mida_free(struct map_entry_md, names[8]);
+
+    // Unlinking and freeing while iterating
+    for (it = mida_map_next(&map, NULL); it;) {
+        void *next = mida_map_next(&map, it);
+
+        mida_map_unlink(&map, it);
+        mida_free(struct map_entry_md, it);
+        it = next;
+        ++count;
+    }
+    ASSERT_EQ(98, count);
+    ASSERT_EQ(0, map.count);
+    mida_map_cleanup(&map);
+    PASS();
+}
+
+struct map_id_md {
+    long refs;
+    struct mida_hnode link;
+};
+
+TEST
+test_map_hash_key(void)
+{
+    struct mida_map map;
+    long *values[1000];
+
+    // Without eq, the hash is the key
+    mida_map_init(&map, struct map_id_md, link, NULL);
+    for (long i = 0; i < 1000; i++) {
+        values[i] = mida_malloc(struct map_id_md, sizeof(long), 1);
+        *values[i] = i * 10;
+        ASSERT_EQ(0, mida_map_insert(&map, values[i], (uint64_t)i));
+    }
+    for (long i = 0; i < 1000; i++) {
+        long *found = mida_map_find(&map, (uint64_t)i, NULL);
+
+        ASSERT_EQ(values[i], found);
+        ASSERT_EQ(i * 10, *found);
+    }
+    ASSERT_EQ(NULL, mida_map_find(&map, 1000, NULL));
+    for (long i = 0; i < 1000; i++) {
+        ASSERT_EQ(values[i], mida_map_remove(&map, (uint64_t)i, NULL));
+        mida_free(struct map_id_md, values[i]);
+    }
+    ASSERT_EQ(0, map.count);
+    mida_map_cleanup(&map);
+    PASS();
+}
+
+struct lru_md {
+    struct mida_lru_node node;
+    size_t length;
+};
+
+struct lru_log {
+    void *evicted[16];
+    int count;
+};
+
+static void
+_lru_log_evict(void *base, void *context)
+{
+    struct lru_log *log = context;
+    log->evicted[log->count++] = base;
+    mida_free(struct lru_md, base);
+}
+
+static int *
+_lru_object(int value)
+{
+    int *object = mida_calloc(struct lru_md, sizeof(int), 10);
+    MIDA(struct lru_md, object)->length = 10;
+    object[0] = value;
+    return object;
+}
+
+TEST
+test_lru(void)
+{
+    struct lru_log log = { { 0 }, 0 };
+    struct mida_lru lru;
+    int *objects[5];
+    size_t hits, misses, bytes;
+
+    // Hashes below 2^40 all land in the first shard, with 100 bytes
+    mida_lru_init(&lru, struct lru_md, node, 100 * MIDA_LRU_SHARDS, NULL,
+                  _lru_log_evict, &log);
+    for (int i = 0; i < 3; i++) {
+        objects[i] = _lru_object(i);
+        ASSERT_EQ(0, mida_lru_put(&lru, objects[i], (uint64_t)i, NULL, 40));
+    }
+    // 120 bytes, the least recently used goes
+    ASSERT_EQ(1, log.count);
+    ASSERT_EQ(objects[0], log.evicted[0]);
+    ASSERT_EQ(NULL, mida_lru_get(&lru, 0, NULL));
+
+    ASSERT_EQ(objects[1], mida_lru_get(&lru, 1, NULL));
+    ASSERT_EQ(1, *objects[1]);
+    mida_lru_release(&lru, objects[1]);
+
+    // 1 was used more recently than 2
+    objects[3] = _lru_object(3);
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[3], 3, NULL, 40));
+    ASSERT_EQ(2, log.count);
+    ASSERT_EQ(objects[2], log.evicted[1]);
+
+    // Replacing a key evicts the previous object
+    objects[4] = _lru_object(4);
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[4], 3, NULL, 40));
+    ASSERT_EQ(3, log.count);
+    ASSERT_EQ(objects[3], log.evicted[2]);
+    ASSERT_EQ(objects[4], mida_lru_get(&lru, 3, NULL));
+    mida_lru_release(&lru, objects[4]);
+
+    // Putting a cached object again only updates its bytes and recency
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[1], 1, NULL, 50));
+    ASSERT_EQ(3, log.count);
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[4], 3, NULL, 60));
+    ASSERT_EQ(4, log.count);
+    ASSERT_EQ(objects[1], log.evicted[3]);
+    ASSERT_EQ(objects[4], mida_lru_get(&lru, 3, NULL));
+    mida_lru_release(&lru, objects[4]);
+
+    mida_lru_stats(&lru, &hits, &misses, &bytes);
+    ASSERT_EQ(3, hits);
+    ASSERT_EQ(1, misses);
+    ASSERT_EQ(60, bytes);
+
+    mida_lru_cleanup(&lru);
+    ASSERT_EQ(5, log.count);
+
+    // Put again after being evicted while referenced, keeping the reference
+    log.count = 0;
+    mida_lru_init(&lru, struct lru_md, node, 100 * MIDA_LRU_SHARDS, NULL,
+                  _lru_log_evict, &log);
+    objects[0] = _lru_object(0);
+    objects[1] = _lru_object(1);
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[0], 7, NULL, 10));
+    ASSERT_EQ(objects[0], mida_lru_get(&lru, 7, NULL));
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[1], 7, NULL, 10));
+    ASSERT_EQ(0, log.count);
+    ASSERT_EQ(0, mida_lru_put(&lru, objects[0], 7, NULL, 10));
+    ASSERT_EQ(1, log.count);
+    ASSERT_EQ(objects[1], log.evicted[0]);
+    mida_lru_release(&lru, objects[0]);
+    ASSERT_EQ(1, log.count);
+    ASSERT_EQ(objects[0], mida_lru_get(&lru, 7, NULL));
+    mida_lru_release(&lru, objects[0]);
+
+    // An object can't be cached under two keys
+    ASSERT_EQ(-1, mida_lru_put(&lru, objects[0], 8, NULL, 10));
+    ASSERT_EQ(-1, mida_lru_put(&lru, objects[0], (uint64_t)1 << 40, NULL, 10));
+    ASSERT_EQ(NULL, mida_lru_get(&lru, 8, NULL));
+    mida_lru_stats(&lru, NULL, NULL, &bytes);
+    ASSERT_EQ(10, bytes);
+
+    mida_lru_cleanup(&lru);
+    ASSERT_EQ(2, log.count);
+    ASSERT_EQ(objects[0], log.evicted[1]);
+    PASS();
+}
+
+TEST
+test_lru_referenced(void)
+{
+    struct lru_log log = { { 0 }, 0 };
+    struct mida_lru lru;
+    int *held, *other;
+
+    mida_lru_init(&lru, struct lru_md, node, 100 * MIDA_LRU_SHARDS, NULL,
+                  _lru_log_evict, &log);
+    held = _lru_object(1);
+    ASSERT_EQ(0, mida_lru_put(&lru, held, 1, NULL, 60));
+    ASSERT_EQ(held, mida_lru_get(&lru, 1, NULL));
+
+    // Evicted while referenced, released on the last reference
+    other = _lru_object(2);
+    ASSERT_EQ(0, mida_lru_put(&lru, other, 2, NULL, 60));
+    ASSERT_EQ(0, log.count);
+    ASSERT_EQ(NULL, mida_lru_get(&lru, 1, NULL));
+    ASSERT_EQ(1, held[0]);
+    mida_lru_release(&lru, held);
+    ASSERT_EQ(1, log.count);
+    ASSERT_EQ(held, log.evicted[0]);
+
+    mida_lru_cleanup(&lru);
+    ASSERT_EQ(2, log.count);
+    PASS();
+}
+
+static struct mida_lru lru_shared;
+
+static void
+_lru_free(void *base, void *context)
+{
+    (void)context;
+    mida_free(struct lru_md, base);
+}
+
+static void *
+_lru_worker(void *arg)
+{
+    unsigned seed = (unsigned)(uintptr_t)arg;
+
+    for (int i = 0; i < 20000; i++) {
+        uint64_t key;
+        int *object;
+
+        seed = seed * 1103515245 + 12345;
+        key = mida_hash(&seed, sizeof seed) % 500;
+        key = mida_hash(&key, sizeof key);
+        if ((object = mida_lru_get(&lru_shared, key, NULL)) != NULL) {
+            if (MIDA(struct lru_md, object)->length != 10) return object;
+            mida_lru_release(&lru_shared, object);
+            continue;
+        }
+        object = _lru_object(0);
+        if (mida_lru_put(&lru_shared, object, key, NULL, 64)) return object;
+    }
+    return NULL;
+}
+
+TEST
+test_lru_threads(void)
+{
+    pthread_t threads[4];
+    size_t hits, misses, bytes;
+
+    mida_lru_init(&lru_shared, struct lru_md, node, 64 * 200, NULL,
+                  _lru_free, NULL);
+    for (int t = 0; t < 4; t++) {
+        pthread_create(&threads[t], NULL, _lru_worker, (void *)(uintptr_t)t);
+    }
+    for (int t = 0; t < 4; t++) {
+        void *failed;
+        pthread_join(threads[t], &failed);
+        ASSERT_EQ(NULL, failed);
+    }
+    mida_lru_stats(&lru_shared, &hits, &misses, &bytes);
+    ASSERT_EQ(80000, hits + misses);
+    ASSERT(hits > 0);
+    ASSERT(bytes <= 64 * 200);
+    mida_lru_cleanup(&lru_shared);
+    mida_lru_stats(&lru_shared, NULL, NULL, &bytes);
+    ASSERT_EQ(0, bytes);
+    PASS();
+}
+
+struct vec_md {
+    size_t length;
+    size_t capacity;
+};
+
+struct vec_point {
+    int x, y;
+};
+
+MIDA_DEFINE_VEC(int_vec, struct vec_md, int)
+MIDA_DEFINE_VEC(point_vec, struct vec_md, struct vec_point)
+
+static int
+_int_cmp(const int *a, const int *b)
+{
+    return (*a > *b) - (*a < *b);
+}
+
+static int
+_point_cmp(const struct vec_point *a, const struct vec_point *b)
+{
+    return a->x != b->x ? (a->x > b->x) - (a->x < b->x)
+                        : (a->y > b->y) - (a->y < b->y);
+}
+
+TEST
+test_vec(void)
+{
+    int *vec = NULL;
+    int value = 42;
+    unsigned seed = 1;
+
+    ASSERT_EQ(0, int_vec_length(vec));
+    for (int i = 0; i < 1000; i++) {
+        seed = seed * 1103515245 + 12345;
+        ASSERT_EQ(0, int_vec_push(&vec, (int)(seed >> 16) % 500));
+    }
+    ASSERT_EQ(0, int_vec_push(&vec, value));
+    ASSERT_EQ(1001, int_vec_length(vec));
+    ASSERT_EQ(1001, MIDA(struct vec_md, vec)->length);
+    ASSERT(MIDA(struct vec_md, vec)->capacity >= 1001);
+    ASSERT_EQ(42, int_vec_get(vec, 1000));
+
+    int_vec_sort(vec, _int_cmp);
+    for (size_t i = 1; i < int_vec_length(vec); i++) {
+        ASSERT(vec[i - 1] <= vec[i]);
+    }
+    ASSERT_EQ(42, *int_vec_find(vec, &value, _int_cmp));
+    value = 500;
+    ASSERT_EQ(NULL, int_vec_find(vec, &value, NULL));
+
+    ASSERT_EQ(0, int_vec_resize(&vec, 2000));
+    ASSERT_EQ(2000, int_vec_length(vec));
+    ASSERT_EQ(0, vec[1999]);
+    ASSERT_EQ(0, int_vec_resize(&vec, 10));
+    ASSERT_EQ(10, int_vec_length(vec));
+
+    int_vec_free(vec);
+    PASS();
+}
+
+TEST
+test_vec_struct(void)
+{
+    struct vec_point *points = point_vec_new(4);
+    struct vec_point wanted = { 3, 1 };
+
+    ASSERT(points != NULL);
+    ASSERT_EQ(0, point_vec_length(points));
+    ASSERT_EQ(4, MIDA(struct vec_md, points)->capacity);
+    // Reverse order, with runs of equal keys to sort
+    for (int i = 99; i >= 0; i--) {
+        struct vec_point point = { i / 3, i % 3 };
+        ASSERT_EQ(0, point_vec_push(&points, point));
+    }
+    point_vec_sort(points, _point_cmp);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(i / 3, points[i].x);
+        ASSERT_EQ(i % 3, points[i].y);
+    }
+    ASSERT_EQ(&points[10], point_vec_find(points, &wanted, _point_cmp));
+    ASSERT_EQ(&points[10], point_vec_find(points, &wanted, NULL));
+
+    point_vec_free(points);
+    point_vec_free(NULL);
+    PASS();
+}
+
+static void
+_parallel_count(void *base, size_t first, size_t last, void *context)
+{
+    int *array = base;
+
+    (void)context;
+    for (size_t i = first; i < last; i++)
+        __atomic_add_fetch(&array[i], 1, __ATOMIC_RELAXED);
+}
+
+TEST
+test_parallel_for(void)
+{
+    const size_t chunks[] = { 1, 7, 0, 100000 };
+    int *array = test_malloc(sizeof(int), 10000);
+
+    ASSERT_EQ(0, mida_parallel_start(4));
+    ASSERT_EQ(-1, mida_parallel_start(4));
+    for (size_t c = 0; c < sizeof chunks / sizeof *chunks; c++) {
+        memset(array, 0, 10000 * sizeof(int));
+        mida_parallel_for(MD, array, chunks[c], _parallel_count, NULL);
+        // Every element is visited exactly once
+        for (int i = 0; i < 10000; i++)
+            ASSERT_EQ_FMT(1, array[i], "%d");
+    }
+    mida_parallel_stop();
+    mida_free(MD, array);
+    PASS();
+}
+
+struct parallel_stats {
+    long sum;
+    int min, max;
+};
+
+static void
+_parallel_stats(
+    void *base, size_t first, size_t last, void *partial, void *context)
+{
+    const int *array = base;
+    struct parallel_stats *stats = partial;
+
+    (void)context;
+    for (size_t i = first; i < last; i++) {
+        stats->sum += array[i];
+        if (array[i] < stats->min) stats->min = array[i];
+        if (array[i] > stats->max) stats->max = array[i];
+    }
+}
+
+static void
+_parallel_stats_combine(void *result, const void *partial, void *context)
+{
+    struct parallel_stats *stats = result;
+    const struct parallel_stats *other = partial;
+
+    (void)context;
+    stats->sum += other->sum;
+    if (other->min < stats->min) stats->min = other->min;
+    if (other->max > stats->max) stats->max = other->max;
+}
+
+TEST
+test_parallel_reduce(void)
+{
+    int *array = test_malloc(sizeof(int), 100000);
+    struct parallel_stats stats = { 0, INT_MAX, INT_MIN };
+
+    for (int i = 0; i < 100000; i++)
+        array[i] = (i * 7919) % 100000 - 50000;
+    ASSERT_EQ(0, mida_parallel_start(3));
+    mida_parallel_reduce(MD, array, 64, &stats, _parallel_stats,
+                         _parallel_stats_combine, NULL);
+    ASSERT_EQ(-50000L, stats.sum);
+    ASSERT_EQ(-50000, stats.min);
+    ASSERT_EQ(49999, stats.max);
+    mida_parallel_stop();
+
+    // Runs serially, without a pool nor more than one chunk
+    stats.sum = 0, stats.min = INT_MAX, stats.max = INT_MIN;
+    mida_parallel_reduce(MD, array, 100000, &stats, _parallel_stats,
+                         _parallel_stats_combine, NULL);
+    ASSERT_EQ(-50000L, stats.sum);
+    ASSERT_EQ(-50000, stats.min);
+    mida_parallel_stop();
+    mida_free(MD, array);
+    PASS();
+}
+
+static void
+_parallel_nested(void *base, size_t first, size_t last, void *context)
+{
+    int **rows = base;
+
+    (void)context;
+    // The pool is busy, so the inner loops run on the current thread
+    for (size_t i = first; i < last; i++)
+        mida_parallel_for(MD, rows[i], 1, _parallel_count, NULL);
+}
+
+TEST
+test_parallel_nested(void)
+{
+    int **rows = test_malloc(sizeof(int *), 16);
+
+    for (int i = 0; i < 16; i++)
+        rows[i] = test_calloc(sizeof(int), 100);
+    ASSERT_EQ(0, mida_parallel_start(4));
+    mida_parallel_for(MD, rows, 1, _parallel_nested, NULL);
+    mida_parallel_stop();
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 100; j++)
+            ASSERT_EQ(1, rows[i][j]);
+        mida_free(MD, rows[i]);
+    }
+    mida_free(MD, rows);
+    PASS();
+}
+
+struct agg_md {
+    size_t length;
+    struct mida_agg agg;
+};
+
+static double *
+_agg_array(size_t length)
+{
+    double *values = mida_calloc(struct agg_md, sizeof(double), length);
+    MIDA(struct agg_md, values)->length = length;
+    return values;
+}
+
+TEST
+test_agg(void)
+{
+    double *values = _agg_array(1000);
+
+    for (int i = 0; i < 1000; i++)
+        values[i] = (double)((i * 7919) % 1000 - 500);
+    ASSERT_EQ(-500.0, mida_agg_sum(struct agg_md, agg, values));
+    ASSERT_EQ(-500.0, mida_agg_min(struct agg_md, agg, values));
+    ASSERT_EQ(499.0, mida_agg_max(struct agg_md, agg, values));
+    ASSERT_EQ(-0.5, mida_agg_mean(struct agg_md, agg, values));
+
+    // Cached until told about the modification
+    values[0] = 10000;
+    ASSERT_EQ(499.0, mida_agg_max(struct agg_md, agg, values));
+    mida_agg_touch(struct agg_md, agg, values);
+    ASSERT_EQ(10000.0, mida_agg_max(struct agg_md, agg, values));
+    ASSERT_EQ(10000.0, mida_agg_sum(struct agg_md, agg, values));
+
+    mida_agg_set(struct agg_md, agg, values, 1, -10000.0);
+    ASSERT_EQ(-10000.0, mida_agg_min(struct agg_md, agg, values));
+
+    // A new length invalidates as well
+    MIDA(struct agg_md, values)->length = 1;
+    ASSERT_EQ(10000.0, mida_agg_sum(struct agg_md, agg, values));
+    ASSERT_EQ(10000.0, mida_agg_min(struct agg_md, agg, values));
+    MIDA(struct agg_md, values)->length = 0;
+    ASSERT_EQ(0.0, mida_agg_sum(struct agg_md, agg, values));
+    ASSERT_EQ(0.0, mida_agg_max(struct agg_md, agg, values));
+    ASSERT_EQ(0.0, mida_agg_mean(struct agg_md, agg, values));
+    mida_free(struct agg_md, values);
+    PASS();
+}
+
+static enum greatest_test_res
+_agg_check(void)
+{
+    // Every tail length, with the extremes at every position
+    for (size_t n = 1; n <= 40; n++) {
+        double *values = _agg_array(n);
+
+        for (size_t at = 0; at < n; at++) {
+            double sum = 0;
+
+            for (size_t i = 0; i < n; i++)
+                values[i] = (double)(i % 5);
+            values[(at + 1) % n] = 9;
+            values[at] = -3;
+            for (size_t i = 0; i < n; i++)
+                sum += values[i];
+            mida_agg_touch(struct agg_md, agg, values);
+            ASSERT_EQ(sum, mida_agg_sum(struct agg_md, agg, values));
+            ASSERT_EQ(-3.0, mida_agg_min(struct agg_md, agg, values));
+            ASSERT_EQ(n > 1 ? 9.0 : -3.0,
+                      mida_agg_max(struct agg_md, agg, values));
+        }
+        mida_free(struct agg_md, values);
+    }
+    PASS();
+}
+
+TEST
+test_agg_kernels(void)
+{
+    CHECK_CALL(_agg_check());
+#ifdef MIDA_WITH_SSE2
+    // Same again without AVX2
+    {
+        const int avx2 = __mida_avx2;
+
+        __mida_avx2 = 0;
+        CHECK_CALL(_agg_check());
+        __mida_avx2 = avx2;
+    }
+#endif
+    PASS();
+}
+
+struct agg_int_md {
+    size_t length;
+    struct mida_agg_int agg;
+};
+
+static enum greatest_test_res
+_agg_int_check(void)
+{
+    // Every tail length, with the extremes at every position
+    for (size_t n = 1; n <= 40; n++) {
+        int *ints = mida_calloc(struct agg_int_md, sizeof(int), n);
+        int64_t *wide = mida_calloc(struct agg_int_md, sizeof(int64_t), n);
+        const struct mida_agg_int *agg;
+
+        MIDA(struct agg_int_md, ints)->length = n;
+        MIDA(struct agg_int_md, wide)->length = n;
+        for (size_t at = 0; at < n; at++) {
+            int64_t sum = 0;
+
+            for (size_t i = 0; i < n; i++)
+                ints[i] = INT_MAX - (int)(i % 5);
+            ints[(at + 1) % n] = INT_MAX;
+            ints[at] = INT_MIN;
+            for (size_t i = 0; i < n; i++) {
+                sum += ints[i];
+                wide[i] = (int64_t)ints[i] * 4;
+            }
+            mida_agg_touch(struct agg_int_md, agg, ints);
+            agg = mida_agg_int(struct agg_int_md, agg, ints);
+            ASSERT_EQ(sum, agg->sum);
+            ASSERT_EQ(INT_MIN, agg->min);
+            ASSERT_EQ(n > 1 ? INT_MAX : INT_MIN, agg->max);
+
+            mida_agg_touch(struct agg_int_md, agg, wide);
+            agg = mida_agg_int64(struct agg_int_md, agg, wide);
+            ASSERT_EQ(sum * 4, agg->sum);
+            ASSERT_EQ((int64_t)INT_MIN * 4, agg->min);
+            ASSERT_EQ((n > 1 ? (int64_t)INT_MAX : INT_MIN) * 4, agg->max);
+        }
+        mida_free(struct agg_int_md, ints);
+        mida_free(struct agg_int_md, wide);
+    }
+    PASS();
+}
+
+TEST
+test_agg_int(void)
+{
+    int *scores = mida_calloc(struct agg_int_md, sizeof(int), 4);
+    const struct mida_agg_int *agg;
+
+    MIDA(struct agg_int_md, scores)->length = 4;
+    scores[0] = 85, scores[1] = 92, scores[2] = 78, scores[3] = 90;
+    agg = mida_agg_int(struct agg_int_md, agg, scores);
+    ASSERT_EQ(345, agg->sum);
+    ASSERT_EQ(78, agg->min);
+    ASSERT_EQ(92, agg->max);
+    ASSERT_EQ(86.25, agg->mean);
+
+    // Cached and invalidated like the double aggregates
+    mida_agg_set(struct agg_int_md, agg, scores, 2, 100);
+    agg = mida_agg_int(struct agg_int_md, agg, scores);
+    ASSERT_EQ(85, agg->min);
+    ASSERT_EQ(100, agg->max);
+    MIDA(struct agg_int_md, scores)->length = 0;
+    agg = mida_agg_int(struct agg_int_md, agg, scores);
+    ASSERT_EQ(0, agg->sum);
+    ASSERT_EQ(0.0, agg->mean);
+    mida_free(struct agg_int_md, scores);
+
+    CHECK_CALL(_agg_int_check());
+#ifdef MIDA_WITH_SSE2
+    // Same again without AVX2
+    {
+        const int avx2 = __mida_avx2;
+
+        __mida_avx2 = 0;
+        CHECK_CALL(_agg_int_check());
+        __mida_avx2 = avx2;
+    }
+#endif
+    PASS();
+}
+
+static void
+_column_collect(size_t index, int64_t value, void *context)
+{
+    int64_t *sum = context;
+
+    *sum += value + (int64_t)index;
+}
+
+TEST
+test_column(void)
+{
+    int64_t *column = NULL;
+    const struct mida_zone *zones;
+
+    // Three blocks of increasing values, with nulls in the second one
+    for (int i = 0; i < 3 * MIDA_COLUMN_BLOCK; i++) {
+        const int64_t value = i / MIDA_COLUMN_BLOCK == 1 && i % 100 == 50
+                                  ? MIDA_COLUMN_NULL
+                                  : i;
+        ASSERT_EQ(0, mida_column_push(&column, value));
+    }
+    ASSERT_EQ(3 * MIDA_COLUMN_BLOCK, mida_column_length(column));
+    zones = MIDA(struct mida_column, column)->zones;
+    ASSERT_EQ(0, zones[0].min);
+    ASSERT_EQ(MIDA_COLUMN_BLOCK - 1, zones[0].max);
+    ASSERT_EQ(0, zones[0].nulls);
+    ASSERT_EQ(MIDA_COLUMN_BLOCK, zones[1].min);
+    ASSERT_EQ(10, zones[1].nulls);
+
+    // Nulls don't match, even with the widest range
+    ASSERT_EQ(3 * MIDA_COLUMN_BLOCK - 10,
+              mida_column_scan(column, INT64_MIN, INT64_MAX, NULL, NULL));
+    ASSERT_EQ(0, mida_column_scan(column, -100, -1, NULL, NULL));
+    ASSERT_EQ(0, mida_column_scan(column, 5, 4, NULL, NULL));
+    ASSERT_EQ(11, mida_column_scan(column, 10, 20, NULL, NULL));
+
+    // Replacing the bound of a block shrinks its zone
+    mida_column_set(column, 0, 500);
+    ASSERT_EQ(1, zones[0].min);
+    mida_column_set(column, MIDA_COLUMN_BLOCK - 1, MIDA_COLUMN_NULL);
+    ASSERT_EQ(MIDA_COLUMN_BLOCK - 2, zones[0].max);
+    ASSERT_EQ(1, zones[0].nulls);
+    mida_column_set(column, MIDA_COLUMN_BLOCK - 1, -7);
+    ASSERT_EQ(-7, zones[0].min);
+    ASSERT_EQ(0, zones[0].nulls);
+    ASSERT_EQ(1, mida_column_scan(column, -7, -7, NULL, NULL));
+
+    mida_column_free(column);
+    PASS();
+}
+
+static enum greatest_test_res
+_column_check(const int64_t *column, size_t length)
+{
+    unsigned seed = 7;
+
+    for (int q = 0; q < 200; q++) {
+        int64_t lo, hi, sum = 0, expected_sum = 0;
+        size_t expected = 0;
+
+        seed = seed * 1103515245 + 12345;
+        lo = (int64_t)(seed >> 8) % 20000 - 1000;
+        seed = seed * 1103515245 + 12345;
+        hi = lo + (int64_t)(seed >> 8) % (q < 100 ? 50 : 5000);
+        for (size_t i = 0; i < length; i++)
+            if (column[i] != MIDA_COLUMN_NULL && column[i] >= lo
+                && column[i] <= hi)
+            {
+                ++expected;
+                expected_sum += column[i] + (int64_t)i;
+            }
+        ASSERT_EQ(expected, mida_column_scan(column, lo, hi, NULL, NULL));
+        ASSERT_EQ(expected, mida_column_scan(column, lo, hi,
+                                             _column_collect, &sum));
+        ASSERT_EQ(expected_sum, sum);
+    }
+    PASS();
+}
+
+TEST
+test_column_scan(void)
+{
+    const size_t length = 10 * MIDA_COLUMN_BLOCK + 123;
+    int64_t *column = mida_column_new(0);
+    unsigned seed = 1;
+
+    // Mostly increasing, as timestamps, with noise and nulls
+    for (size_t i = 0; i < length; i++) {
+        int64_t value;
+
+        seed = seed * 1103515245 + 12345;
+        value = (int64_t)i * 2 + (int64_t)(seed >> 16) % 64;
+        ASSERT_EQ(0, mida_column_push(&column, seed % 97 ? value
+                                                         : MIDA_COLUMN_NULL));
+    }
+    CHECK_CALL(_column_check(column, length));
+#ifdef MIDA_WITH_SSE2
+    // Same again without AVX2
+    {
+        const int avx2 = __mida_avx2;
+
+        __mida_avx2 = 0;
+        CHECK_CALL(_column_check(column, length));
+        __mida_avx2 = avx2;
+    }
+#endif
+    mida_column_free(column);
+    PASS();
+}
+
+static enum greatest_test_res
+_pack_check(const int64_t *values, size_t length)
+{
+    uint64_t *packed = mida_pack(values, length);
+    int64_t *decoded = malloc((length + MIDA_PACK_BLOCK) * sizeof *decoded);
+    struct mida_pack_iter iter;
+    int64_t value;
+    size_t count = 0;
+
+    ASSERT(packed != NULL);
+    ASSERT_EQ(length, mida_pack_length(packed));
+    for (size_t i = 0; i < length; i++)
+        ASSERT_EQ(values[i], mida_pack_get(packed, i));
+
+    ASSERT_EQ(length, mida_pack_decode(packed, 0, length + 5, decoded));
+    ASSERT_MEM_EQ(values, decoded, length * sizeof *values);
+    // Unaligned ranges, across blocks
+    if (length > 200) {
+        ASSERT_EQ(150, mida_pack_decode(packed, 50, 150, decoded));
+        ASSERT_MEM_EQ(&values[50], decoded, 150 * sizeof *values);
+    }
+    ASSERT_EQ(0, mida_pack_decode(packed, length, 1, decoded));
+
+    mida_pack_iter_init(&iter, packed);
+    while (mida_pack_iter_next(&iter, &value)) {
+        ASSERT_EQ(values[count], value);
+        count++;
+    }
+    ASSERT_EQ(length, count);
+
+    free(decoded);
+    mida_pack_free(packed);
+    PASS();
+}
+
+TEST
+test_pack(void)
+{
+    int64_t values[1000];
+    const struct mida_pack_block *blocks;
+    uint64_t *packed;
+
+    // Timestamps every ~10ms, encoded as differences of 0 to 7 + 1000
+    values[0] = 1700000000000LL;
+    for (int i = 1; i < 1000; i++)
+        values[i] = values[i - 1] + 1000 + (i * 7) % 8;
+    packed = mida_pack(values, 1000);
+    blocks = MIDA(struct mida_packed, packed)->blocks;
+    ASSERT_EQ(MIDA_PACK_DELTA, blocks[0].encoding);
+    ASSERT_EQ(3, blocks[0].width);
+    ASSERT_EQ(1000, blocks[0].reference);
+    // Far less than the 8000 bytes of the input
+    ASSERT(MIDA(struct mida_packed, packed)->words * sizeof(uint64_t) < 400);
+    mida_pack_free(packed);
+    CHECK_CALL(_pack_check(values, 1000));
+
+    // Unordered small values, as offsets from the smallest one
+    for (int i = 0; i < 1000; i++)
+        values[i] = -5000 + (i * 7919) % 200;
+    packed = mida_pack(values, 1000);
+    blocks = MIDA(struct mida_packed, packed)->blocks;
+    ASSERT_EQ(MIDA_PACK_FOR, blocks[0].encoding);
+    ASSERT_EQ(8, blocks[0].width);
+    mida_pack_free(packed);
+    CHECK_CALL(_pack_check(values, 1000));
+
+    // Constant values take no words at all
+    for (int i = 0; i < 1000; i++)
+        values[i] = 42;
+    packed = mida_pack(values, 1000);
+    ASSERT_EQ(0, MIDA(struct mida_packed, packed)->words);
+    mida_pack_free(packed);
+    CHECK_CALL(_pack_check(values, 1000));
+
+    // Extremes, and lengths around a block
+    values[0] = INT64_MIN, values[1] = INT64_MAX, values[2] = -1;
+    for (size_t length = 0; length <= 2 * MIDA_PACK_BLOCK + 1; length++)
+        CHECK_CALL(_pack_check(values, length));
+    PASS();
+}
+
+TEST
+test_pack_widths(void)
+{
+    int64_t values[3 * MIDA_PACK_BLOCK];
+    uint64_t seed = 1;
+
+    for (unsigned width = 1; width <= 64; width++) {
+        const struct mida_pack_block *blocks;
+        uint64_t *packed;
+
+        for (int i = 0; i < 3 * MIDA_PACK_BLOCK; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            values[i] = (int64_t)((seed ^ seed >> 29) >> (64 - width));
+        }
+        // Both ends of the range, for the width to be exact
+        values[0] = width == 64 ? INT64_MIN : 0;
+        values[1] = width == 64 ? INT64_MAX : (int64_t)(~0ULL >> (64 - width));
+        packed = mida_pack(values, 3 * MIDA_PACK_BLOCK);
+        blocks = MIDA(struct mida_packed, packed)->blocks;
+        ASSERT_EQ(MIDA_PACK_FOR, blocks[0].encoding);
+        ASSERT_EQ(width, blocks[0].width);
+        mida_pack_free(packed);
+        CHECK_CALL(_pack_check(values, 3 * MIDA_PACK_BLOCK));
+    }
+    PASS();
+}
+
+SUITE(suite_compound_literals)
+{
+    RUN_TEST(test_init_compound_literals);
+    RUN_TEST(test_init_bytemap);
+    RUN_TEST(test_different_types);
+    RUN_TEST(test_large_array);
+    RUN_TEST(test_deep_nested_arrays);
+    RUN_TEST(test_shallow_mida_deep_nesting);
+}
+
+SUITE(suite_stdlib)
+{
+    RUN_TEST(test_mida_malloc);
+    RUN_TEST(test_mida_calloc);
+    RUN_TEST(test_mida_realloc);
+    RUN_TEST(test_mida_realloc_null);
+}
+
+SUITE(suite_custom_metadata)
+{
+    RUN_TEST(test_custom_metadata);
+    RUN_TEST(test_custom_calloc);
+}
+
+SUITE(suite_chain)
+{
+    RUN_TEST(test_chain_writev);
+    RUN_TEST(test_chain_consume);
+}
+
+SUITE(suite_pkb)
+{
+    RUN_TEST(test_pkb_layers);
+    RUN_TEST(test_pkb_reserve);
+}
+
+SUITE(suite_queue)
+{
+    RUN_TEST(test_mpmc_threads);
+    RUN_TEST(test_spsc_bounds);
+    RUN_TEST(test_mpsc_intrusive);
+}
+
+SUITE(suite_pool)
+{
+    RUN_TEST(test_pool_recycle);
+    RUN_TEST(test_pool_limit_trim);
+    RUN_TEST(test_pool_containers);
+}
+
+SUITE(suite_deferred)
+{
+    RUN_TEST(test_free_deferred);
+    RUN_TEST(test_reclaimer_thread);
+}
+
+SUITE(suite_epoch)
+{
+    RUN_TEST(test_epoch_retire);
+    RUN_TEST(test_epoch_synchronize);
+}
+
+SUITE(suite_seqlock)
+{
+    RUN_TEST(test_meta_seqlock);
+}
+
+SUITE(suite_handles)
+{
+    RUN_TEST(test_handle_generations);
+}
+
+SUITE(suite_soa)
+{
+    RUN_TEST(test_soa_columns);
+}
+
+SUITE(suite_sidetable)
+{
+    RUN_TEST(test_sidetable_foreign);
+    RUN_TEST(test_sidetable_full);
+    RUN_TEST(test_sidetable_churn);
+}
+
+SUITE(suite_layers)
+{
+    RUN_TEST(test_layers_stack);
+}
+
+SUITE(suite_deep)
+{
+    RUN_TEST(test_clone_deep);
+}
+
+SUITE(suite_near)
+{
+    RUN_TEST(test_malloc_near);
+    RUN_TEST(test_malloc_near_overflow);
+}
+
+SUITE(suite_prefetch)
+{
+    RUN_TEST(test_prefetch);
+    RUN_TEST(test_walk);
+}
+
+SUITE(suite_compact)
+{
+    RUN_TEST(test_compact_string);
+    RUN_TEST(test_compact_malloc);
+}
+
+SUITE(suite_str)
+{
+    RUN_TEST(test_str_append);
+    RUN_TEST(test_str_append_self);
+    RUN_TEST(test_str_appendf);
+}
+
+SUITE(suite_hstr)
+{
+    RUN_TEST(test_hash);
+    RUN_TEST(test_hstr);
+    RUN_TEST(test_intern);
+}
+
+SUITE(suite_str_ops)
+{
+    RUN_TEST(test_str_ops);
+    RUN_TEST(test_str_split);
+}
+
+SUITE(suite_map)
+{
+    RUN_TEST(test_map);
+    RUN_TEST(test_map_hash_key);
+}
+
+SUITE(suite_lru)
+{
+    RUN_TEST(test_lru);
+    RUN_TEST(test_lru_referenced);
+    RUN_TEST(test_lru_threads);
+}
+
+SUITE(suite_vec)
+{
+    RUN_TEST(test_vec);
+    RUN_TEST(test_vec_struct);
+}
+
+SUITE(suite_parallel)
+{
+    RUN_TEST(test_parallel_for);
+    RUN_TEST(test_parallel_reduce);
+    RUN_TEST(test_parallel_nested);
+}
+
+SUITE(suite_agg)
+{
+    RUN_TEST(test_agg);
+    RUN_TEST(test_agg_kernels);
+    RUN_TEST(test_agg_int);
+}
+
+SUITE(suite_column)
+{
+    RUN_TEST(test_column);
+    RUN_TEST(test_column_scan);
+}
+
+SUITE(suite_pack)
+{
+    RUN_TEST(test_pack);
+    RUN_TEST(test_pack_widths);
 }
 
 GREATEST_MAIN_DEFS();
@@ -461,5 +2863,30 @@ main(int argc, char *argv[])
     RUN_SUITE(suite_compound_literals);
     RUN_SUITE(suite_stdlib);
     RUN_SUITE(suite_custom_metadata);
+    RUN_SUITE(suite_chain);
+    RUN_SUITE(suite_pkb);
+    RUN_SUITE(suite_queue);
+    RUN_SUITE(suite_pool);
+    RUN_SUITE(suite_deferred);
+    RUN_SUITE(suite_epoch);
+    RUN_SUITE(suite_seqlock);
+    RUN_SUITE(suite_handles);
+    RUN_SUITE(suite_soa);
+    RUN_SUITE(suite_sidetable);
+    RUN_SUITE(suite_layers);
+    RUN_SUITE(suite_deep);
+    RUN_SUITE(suite_near);
+    RUN_SUITE(suite_prefetch);
+    RUN_SUITE(suite_compact);
+    RUN_SUITE(suite_str);
+    RUN_SUITE(suite_hstr);
+    RUN_SUITE(suite_str_ops);
+    RUN_SUITE(suite_map);
+    RUN_SUITE(suite_lru);
+    RUN_SUITE(suite_vec);
+    RUN_SUITE(suite_parallel);
+    RUN_SUITE(suite_agg);
+    RUN_SUITE(suite_column);
+    RUN_SUITE(suite_pack);
     GREATEST_MAIN_END();
 }